@@ -145,6 +145,38 @@ export namespace DialogueContext {
     export const byteSize = 4 + Math.max(Line.byteSize, Slice(Line).byteSize);
   }
 
+  export interface AdvanceResult {
+    /** every line up to the end of the batch */
+    lines: Line[];
+    /** what ended the batch */
+    end: Exclude<StepResult, { line: Line } | { functionCalled: true }>;
+  }
+
+  export namespace AdvanceResult {
+    // 4 byte line count (wasm32), then the StepResult of the end of the batch
+    export const byteSize = 4 + StepResult.byteSize;
+  }
+
+  /** resident bytes of a context by category */
+  export interface MemoryReport {
+    nodes: number;
+    text: number;
+    variables: number;
+    maps: number;
+    scratch: number;
+  }
+
+  export namespace MemoryReport {
+    const fields = ["nodes", "text", "variables", "maps", "scratch"] as const;
+
+    export function unmarshal(view: DataView): MemoryReport {
+      // FIXME: support wasm64
+      return Object.fromEntries(fields.map((field, i) => [field, view.getUint32(4 * i, true)])) as any as MemoryReport;
+    }
+
+    export const byteSize = 4 * fields.length;
+  }
+
   export interface Diagnostic {
     errorMessage: string;
     errorCode: Diagnostic.Errors;
@@ -178,7 +210,10 @@ export namespace DialogueContext {
       AlternisUnknownVersion,
       AlternisBadNextNode,
       AlternisInvalidNode,
-      AlternisDefaultSeedUnsupportedPlatform
+      AlternisDefaultSeedUnsupportedPlatform,
+
+      AlternisAllocatorUnset,
+      AlternisBadCondition
     }
 
     export function unmarshal(helper: WasmHelper<NativeModuleExports>, view: DataView): Diagnostic {
@@ -197,8 +232,8 @@ export namespace DialogueContext {
       };
     }
 
-    // 4 byte boolean with padding, aligned c_int, string slice
-    export const byteSize = 4 + 4 + StringSlice.byteSize;
+    // 4 byte boolean with padding, aligned c_int, string slice, allocator pointer
+    export const byteSize = 4 + 4 + StringSlice.byteSize + 4;
   }
 }
 
@@ -208,6 +243,12 @@ export interface DialogueContext {
   /** reset to the given node_id. 0 always refers to the first node */
   reset(dialogue_id: number, node_id?: number): void;
   reply(dialogue_id: number, replyId: number): void;
+  /** step until the next reply options or the end, returning every line on the way in one call */
+  advance(dialogue_id: number): DialogueContext.AdvanceResult;
+  /** return up to `count` upcoming lines without advancing, stopping early where
+   * what follows isn't known ahead of time (options and function calls)
+   */
+  peek(dialogue_id: number, count: number): DialogueContext.Line[];
   /** returns the numeric id of the node for a given label,
    * which can be used to reset to that node programmatically
    */
@@ -217,6 +258,7 @@ export interface DialogueContext {
   setCallback(name: string, fn: (() => void)): void;
   setVariableBoolean(name: string, value: boolean): void;
   setVariableString(name: string, value: string): void;
+  memoryReport(): DialogueContext.MemoryReport;
 
   // TODO: add support for Symbol.dispose
   dispose(): void;
@@ -234,12 +276,16 @@ interface NativeModuleExports {
   ade_dialogue_ctx_destroy(dialogue_ctx: number): void;
 
   ade_dialogue_ctx_step(dialogue_ctx: number, dialogue_id: number, result_slot: number): void;
+  ade_dialogue_ctx_advance(dialogue_ctx: number, dialogue_id: number, lines: number, lines_len: number, result_slot: number): void;
+  ade_dialogue_ctx_peek(dialogue_ctx: number, dialogue_id: number, lines: number, lines_len: number): number;
   ade_dialogue_ctx_reset(dialogue_ctx: number, dialogue_id: number, node_index: number): void;
   ade_dialogue_ctx_reply(dialogue_ctx: number, dialogue_id: number, reply_id: number): void;
   ade_dialogue_ctx_get_node_by_label(dialogue_ctx: number, dialogue_id: number, label_ptr: number, label_len: number): number;
 
   ade_diagnostic_destroy(diagnostic: number): void;
 
+  ade_dialogue_ctx_memory_report(dialogue_ctx: number, report_slot: number): void;
+
   ade_dialogue_ctx_set_variable_boolean(
     in_dialogue_ctx: number,
     name: number,
@@ -325,6 +371,27 @@ export async function makeDialogueContext(json: string, opts: MakeDialogueContex
   const stepResultPtr = nativeLib._instance.exports.malloc(DialogueContext.StepResult.byteSize);
   const getStepResultView = () => new DataView(nativeLib._instance.exports.memory.buffer, stepResultPtr);
 
+  const advanceResultPtr = nativeLib._instance.exports.malloc(DialogueContext.AdvanceResult.byteSize);
+  const getAdvanceResultView = () => new DataView(nativeLib._instance.exports.memory.buffer, advanceResultPtr);
+
+  /** reused buffer of lines for advance and peek, grown as needed */
+  let linesBufferLen = 64;
+  let linesBufferPtr = nativeLib._instance.exports.malloc(linesBufferLen * DialogueContext.Line.byteSize);
+  const reserveLinesBuffer = (count: number) => {
+    if (count <= linesBufferLen) return;
+    nativeLib._instance.exports.free(linesBufferPtr, linesBufferLen * DialogueContext.Line.byteSize);
+    linesBufferLen = count;
+    linesBufferPtr = nativeLib._instance.exports.malloc(linesBufferLen * DialogueContext.Line.byteSize);
+  };
+  const unmarshalLines = (count: number) => {
+    const lines: DialogueContext.Line[] = [];
+    for (let i = 0; i < count; ++i) {
+      const lineView = new DataView(nativeLib._instance.exports.memory.buffer, linesBufferPtr + i * DialogueContext.Line.byteSize);
+      lines.push(DialogueContext.Line.unmarshal(nativeLib, lineView));
+    }
+    return lines;
+  };
+
   const nativeDlgCtx = nativeLib._instance.exports.ade_dialogue_ctx_create_json(wasmJsonStr.ptr, wasmJsonStr.len, randomSeed, noInterpolate, diagnosticSlot);
   
   const diagnostic = DialogueContext.Diagnostic.unmarshal(nativeLib, getDiagnosticView());
@@ -339,7 +406,7 @@ export async function makeDialogueContext(json: string, opts: MakeDialogueContex
     diagnostic.free();
   }
 
-  /** table of js strings already stored in wasm */
+  /** table of js strings already stored in wasm, only for names since values are unbounded */
   const stringTable = new Map<string, WasmStr>();
 
   const result: DialogueContext = {
@@ -360,6 +427,34 @@ export async function makeDialogueContext(json: string, opts: MakeDialogueContex
       return stepResult!;
     },
 
+    advance(dialogue_id) {
+      const lines: DialogueContext.Line[] = [];
+
+      const MAX_ITERS = globalThis?.__alternis?.MAX_STEP_ITERS ?? 500_000;
+      if (MAX_ITERS <= 0) throw Error(`invalid globalThis.__alternis.MAX_STEP_ITERS of '${MAX_ITERS}'`);
+
+      // callbacks are called synchronously, so keep going past function calls and full buffers
+      for (let i = 0; i < MAX_ITERS; ++i) {
+        nativeLib._instance.exports.ade_dialogue_ctx_advance(nativeDlgCtx, dialogue_id, linesBufferPtr, linesBufferLen, advanceResultPtr);
+        const view = getAdvanceResultView();
+        lines.push(...unmarshalLines(view.getUint32(0, true)));
+        // a full buffer ends the batch with a line tag and no data, so check the tag before unmarshalling
+        const endTag = view.getUint8(4);
+        if (endTag === DialogueContext.StepResult.Tag.Line || endTag === DialogueContext.StepResult.Tag.FunctionCalled)
+          continue;
+        const end = DialogueContext.StepResult.unmarshal(nativeLib, new DataView(view.buffer, view.byteOffset + 4));
+        return { lines, end };
+      }
+
+      throw Error(`dialogue did not reach options or its end within ${MAX_ITERS} iterations`);
+    },
+
+    peek(dialogue_id, count) {
+      reserveLinesBuffer(count);
+      const lineCount = nativeLib._instance.exports.ade_dialogue_ctx_peek(nativeDlgCtx, dialogue_id, linesBufferPtr, count);
+      return unmarshalLines(lineCount);
+    },
+
     reset(dialogue_id, node_id = 0) {
       // FIXME: test for handling invalid ids
       nativeLib._instance.exports.ade_dialogue_ctx_reset(nativeDlgCtx, dialogue_id, node_id);
@@ -408,17 +503,29 @@ export async function makeDialogueContext(json: string, opts: MakeDialogueContex
         stringTable.set(name, wasmName);
       }
 
-      let wasmValue = stringTable.get(value);
-      if (wasmValue === undefined) {
-        wasmValue = nativeLib.marshalString(value);
-        stringTable.set(value, wasmValue);
+      // the value is copied by the context
+      const wasmValue = nativeLib.marshalString(value);
+      try {
+        nativeLib._instance.exports.ade_dialogue_ctx_set_variable_string(nativeDlgCtx, wasmName.ptr, wasmName.len, wasmValue.ptr, wasmValue.len);
+      } finally {
+        wasmValue.free();
       }
+    },
 
-      nativeLib._instance.exports.ade_dialogue_ctx_set_variable_string(nativeDlgCtx, wasmName.ptr, wasmName.len, wasmValue.ptr, wasmValue.len);
+    memoryReport() {
+      const reportPtr = nativeLib._instance.exports.malloc(DialogueContext.MemoryReport.byteSize);
+      try {
+        nativeLib._instance.exports.ade_dialogue_ctx_memory_report(nativeDlgCtx, reportPtr);
+        return DialogueContext.MemoryReport.unmarshal(new DataView(nativeLib._instance.exports.memory.buffer, reportPtr));
+      } finally {
+        nativeLib._instance.exports.free(reportPtr, DialogueContext.MemoryReport.byteSize);
+      }
     },
 
     dispose() {
       nativeLib._instance.exports.free(stepResultPtr, DialogueContext.StepResult.byteSize);
+      nativeLib._instance.exports.free(advanceResultPtr, DialogueContext.AdvanceResult.byteSize);
+      nativeLib._instance.exports.free(linesBufferPtr, linesBufferLen * DialogueContext.Line.byteSize);
       nativeLib._instance.exports.ade_dialogue_ctx_destroy(nativeDlgCtx);
       for (const wasmStr of stringTable.values())
         wasmStr.free();
@@ -54,6 +54,8 @@ async function getWorker() {
 
 export interface WorkerDialogueContext {
   step(dialogue_id: number): Promise<InContextApi.DialogueContext.StepResult>;
+  advance(dialogue_id: number): Promise<InContextApi.DialogueContext.AdvanceResult>;
+  peek(dialogue_id: number, count: number): Promise<InContextApi.DialogueContext.Line[]>;
   reset(dialogue_id: number, node_id: number): Promise<void>;
   reply(dialogue_id: number, replyId: number): Promise<void>;
   getNodeByLabel(dialogue_id: number, label: string): Promise<number>;
@@ -89,6 +91,12 @@ export async function makeDialogueContext(
     async step(dialogue_id) {
       return await asyncPostMessageWithId({ type: "DialogueContext.step", ptr: result.ptr, args: [dialogue_id] });
     },
+    async advance(dialogue_id) {
+      return await asyncPostMessageWithId({ type: "DialogueContext.advance", ptr: result.ptr, args: [dialogue_id] });
+    },
+    async peek(dialogue_id, count) {
+      return await asyncPostMessageWithId({ type: "DialogueContext.peek", ptr: result.ptr, args: [dialogue_id, count] });
+    },
     async reset(dialogue_id, node_id = 0) {
       return asyncPostMessageWithId({ type: "DialogueContext.reset", ptr: result.ptr, args: [dialogue_id, node_id] });
     },
@@ -26,6 +26,16 @@ onmessagePromise.then(onmessage => onmessage(async (msg: any) => {
       if (!ctx) throw Error("no such pointer");
       postMessage({ id, result: ctx.step(...msg.args as [number]) });
 
+    } else if (msg.type === "DialogueContext.advance") {
+      const ctx = ptrMap.get(msg.ptr);
+      if (!ctx) throw Error("no such pointer");
+      postMessage({ id, result: ctx.advance(...msg.args as [number]) });
+
+    } else if (msg.type === "DialogueContext.peek") {
+      const ctx = ptrMap.get(msg.ptr);
+      if (!ctx) throw Error("no such pointer");
+      postMessage({ id, result: ctx.peek(...msg.args as [number, number]) });
+
     } else if (msg.type === "DialogueContext.reset") {
       const ctx = ptrMap.get(msg.ptr);
       if (!ctx) throw Error("no such pointer");
@@ -189,6 +189,41 @@ describe("smoke", () => {
     ctx.dispose();
   });
 
+  it("advance and peek small context in batches", async () => {
+    const ctx = await Api.makeDialogueContext(smallTestJson);
+
+    assert.deepStrictEqual(ctx.peek(0, 1), [
+      { speaker: "test", text: "hello world!", metadata: undefined },
+    ]);
+
+    assert.deepStrictEqual(ctx.advance(0), {
+      lines: [
+        { speaker: "test", text: "hello world!", metadata: undefined },
+        { speaker: "test", text: "goodbye cruel world!", metadata: undefined },
+      ],
+      end: { done: true },
+    });
+
+    assert.deepStrictEqual(ctx.peek(0, 4), []);
+
+    ctx.dispose();
+  });
+
+  it("advance past more lines than fit in one batch", async () => {
+    const lineCount = 150; // more than the initial lines buffer of 64
+    const nodes = Array.from({ length: lineCount }, (_, i) => ({
+      line: { data: { speaker: "test", text: `line ${i}` }, next: i + 1 < lineCount ? i + 1 : null },
+    }));
+    const ctx = await Api.makeDialogueContext(JSON.stringify({ version: 1, dialogues: { long: { nodes } } }));
+
+    const result = ctx.advance(0);
+    assert.deepStrictEqual(result.end, { done: true });
+    assert.strictEqual(result.lines.length, lineCount);
+    result.lines.forEach((line, i) => assert.strictEqual(line.text, `line ${i}`));
+
+    ctx.dispose();
+  });
+
   it("create and run worker context to completion", async () => {
     const ctx = await WorkerApi.makeDialogueContext(smallTestJson);
 
@@ -31,6 +31,47 @@ pub fn build(b: *std.Build) void {
     });
     b.installArtifact(shared_lib);
 
+    const replay_exe = b.addExecutable(.{
+        .name = "alternis-replay",
+        .root_source_file = b.path("src/replay_main.zig"),
+        .target = target,
+        .optimize = optimize,
+    });
+    const install_replay = b.addInstallArtifact(replay_exe, .{});
+    const replay_step = b.step("replay", "Build the trace replay tool");
+    replay_step.dependOn(&install_replay.step);
+
+    const run_replay = b.addRunArtifact(replay_exe);
+    if (b.args) |args| run_replay.addArgs(args);
+    const run_replay_step = b.step("run-replay", "Replay traces against a dialogue, e.g. zig build run-replay -- dialogue.json trace.bin");
+    run_replay_step.dependOn(&run_replay.step);
+
+    const explore_exe = b.addExecutable(.{
+        .name = "alternis-explore",
+        .root_source_file = b.path("src/explore_main.zig"),
+        .target = target,
+        .optimize = optimize,
+    });
+    const install_explore = b.addInstallArtifact(explore_exe, .{});
+    const explore_step = b.step("explore", "Build the dialogue coverage explorer");
+    explore_step.dependOn(&install_explore.step);
+
+    const run_explore = b.addRunArtifact(explore_exe);
+    if (b.args) |args| run_explore.addArgs(args);
+    const run_explore_step = b.step("run-explore", "Explore a dialogue, e.g. zig build run-explore -- dialogue.json");
+    run_explore_step.dependOn(&run_explore.step);
+
+    const compile_bench_exe = b.addExecutable(.{
+        .name = "alternis-compile-bench",
+        .root_source_file = b.path("src/compile_bench_main.zig"),
+        .target = target,
+        .optimize = optimize,
+    });
+    const run_compile_bench = b.addRunArtifact(compile_bench_exe);
+    if (b.args) |args| run_compile_bench.addArgs(args);
+    const run_compile_bench_step = b.step("bench-compile", "Time loading many dialogues on one thread and in parallel, e.g. zig build bench-compile -Doptimize=ReleaseFast");
+    run_compile_bench_step.dependOn(&run_compile_bench.step);
+
     const test_filter = b.option([]const u8, "test-filter", "filter for test subcommand");
     const main_tests = b.addTest(.{
         .root_source_file = b.path("src/c_api.zig"),
@@ -41,8 +82,22 @@ pub fn build(b: *std.Build) void {
     main_tests.linkLibC(); // c api tests use libc malloc as the user configured allocator
     const run_main_tests = b.addRunArtifact(main_tests);
 
+    // compile headers-gen/alternis.hpp in a c++ program against the static lib and run it
+    const hpp_tests = b.addExecutable(.{
+        .name = "alternis-hpp-test",
+        .target = target,
+        .optimize = optimize,
+    });
+    hpp_tests.addCSourceFile(.{ .file = b.path("test/alternis_hpp_test.cpp"), .flags = &.{ "-std=c++17", "-Wall", "-Werror" } });
+    hpp_tests.addIncludePath(b.path("headers-gen"));
+    hpp_tests.linkLibCpp();
+    hpp_tests.linkLibrary(native_lib);
+    const run_hpp_tests = b.addRunArtifact(hpp_tests);
+    run_hpp_tests.setCwd(b.path(".")); // for the test assets
+
     const test_step = b.step("test", "Run library tests");
     test_step.dependOn(&run_main_tests.step);
+    test_step.dependOn(&run_hpp_tests.step);
 
     const web_target_query = CrossTarget.parse(.{ .arch_os_abi = "wasm32-freestanding" }) catch unreachable;
     const web_target = b.resolveTargetQuery(web_target_query);
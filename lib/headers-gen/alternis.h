@@ -22,6 +22,25 @@ typedef uint32_t usz; // configured id type for alternis
  */
 void ade_set_alloc(void*(*const in_malloc)(size_t), void(*const in_free)(void*));
 
+/**
+ * Allocation functions for a single DialogueContext, see DialogueContextCreateOpts.
+ * Every function receives the user pointer.
+ */
+typedef struct AllocatorCallbacks {
+    /* receive an allocation of a certain byte size (like libc malloc) */
+    void* (*malloc)(size_t len, void* user);
+    /**
+     * optional, grow or shrink an allocation *in place*, returning ptr on success,
+     * or NULL if it would have to move, leaving the allocation untouched.
+     * Called for shrinks too, so old_len is always the length last allocated or resized to.
+     * NOTE: libc realloc does not fit, since it may move the allocation
+     */
+    void* (*resize)(void* ptr, size_t old_len, size_t new_len, void* user);
+    /* free a previously allocated region (like libc free) */
+    void (*free)(void* ptr, void* user);
+    void* user;
+} AllocatorCallbacks;
+
 struct DialogueContext;
 
 /* a slice of utf8 characters in memory */
@@ -111,7 +130,11 @@ typedef enum DiagnosticErrors {
     AlternisUnknownVersion,
     AlternisBadNextNode,
     AlternisInvalidNode,
-    AlternisDefaultSeedUnsupportedPlatform
+    AlternisDefaultSeedUnsupportedPlatform,
+
+    AlternisAllocatorUnset,
+    /* a reply condition expression is invalid, see the error message */
+    AlternisBadCondition
 } DiagnosticErrors;
 
 // FIXME: rename to error in the c api since it is not separate from the
@@ -128,6 +151,8 @@ struct Diagnostic {
     int error_code;
     /* a string describing an error */
     StringSlice error_message;
+    /* initialize to NULL. Do not mutate this value, it is internal */
+    const AllocatorCallbacks* _allocator;
 };
 
 /* must be called on diagnostics that were passed to any functions */
@@ -152,6 +177,276 @@ DialogueContext* ade_dialogue_ctx_create_json(
     Diagnostic* const c_diagnostic
 );
 
+/* possible encodings of the strings in step results */
+enum TextEncoding {
+    TEXT_ENCODING_UTF8,
+    /**
+     * little endian utf16, e.g. to copy directly into TCHAR strings.
+     * The StringSlice ptr then points to utf16 code units, but its len is still in bytes
+     */
+    TEXT_ENCODING_UTF16
+};
+
+/**
+ * Receives the bytes of a context's binary trace whenever its buffer fills,
+ * e.g. to append them to a file. See the alternis-replay tool
+ */
+typedef struct TraceSink {
+    void (*write)(void* user, const char* ptr, size_t len);
+    void* user;
+} TraceSink;
+
+/**
+ * Variables shared by many DialogueContexts, e.g. world flags like
+ * "met the king" which every dialogue should see once the game sets them.
+ * Contexts may step on any thread while the world state is written.
+ */
+typedef struct WorldState WorldState;
+
+/**
+ * Create a WorldState with a fixed set of variables, all initially
+ * false or unset. The names are copied. Returns NULL if allocating failed
+ */
+WorldState* ade_world_state_create(
+    const StringSlice* boolean_names_ptr,
+    size_t boolean_names_len,
+    const StringSlice* string_names_ptr,
+    size_t string_names_len
+);
+
+/** destroy a WorldState, every context using it must be destroyed first */
+void ade_world_state_destroy(WorldState* world);
+
+/** may be called from any thread, returns false if there is no such variable */
+zigbool ade_world_state_set_boolean(WorldState* world, const char* name, size_t name_len, zigbool value);
+
+/** returns false if there is no such variable */
+zigbool ade_world_state_get_boolean(WorldState* world, const char* name, size_t name_len);
+
+/**
+ * the value is copied, may be called from any thread.
+ * Returns false if there is no such variable or allocating failed
+ */
+zigbool ade_world_state_set_string(
+    WorldState* world,
+    const char* name,
+    size_t name_len,
+    const char* value,
+    size_t value_len
+);
+
+/* options for ade_dialogue_ctx_create_json_opts */
+typedef struct DialogueContextCreateOpts {
+    /** random seed to use for choice nodes */
+    uint64_t random_seed;
+    /** disable interpolating of text with braces (e.g. "hello {name}") */
+    zigbool no_interpolate;
+    /**
+     * a value of type TextEncoding for the strings in step results.
+     * Static texts are transcoded once when creating the context
+     */
+    unsigned char output_encoding;
+    /**
+     * serve the context's many small allocations from pooled size classes,
+     * which are all freed at once when the context is destroyed
+     */
+    zigbool use_pool_allocator;
+    /**
+     * if not NULL, all memory of the context comes from these callbacks instead
+     * of the allocator from ade_set_alloc. They must outlive the context, and any
+     * Diagnostic from creating it
+     */
+    const AllocatorCallbacks* allocator;
+    /**
+     * if not NULL, the dialogue's variables with the same name and type as a variable
+     * of this world state are read from and written to it. Must outlive the context
+     */
+    WorldState* world_state;
+    /**
+     * if not NULL, record a binary trace of everything the context does, which
+     * alternis-replay can replay to check that a dialogue still steps the same way.
+     * Must outlive the context
+     */
+    const TraceSink* trace_sink;
+    /** the size of the trace buffer, 0 for a default of 4096 bytes */
+    size_t trace_buffer_len;
+    /**
+     * the number of threads to compile the dialogues on, 1 to compile on the calling thread,
+     * and 0 for one per core when there are enough dialogues for it to pay off.
+     * The allocator is only called from one thread at a time
+     */
+    uint32_t compile_thread_count;
+    /**
+     * if not 0, stepping pushes lines, calls and lock/unlock changes as events into a
+     * lock-free ring of this many events (rounded up to a power of two), and call nodes
+     * no longer call their callbacks. See ade_dialogue_ctx_drain_events
+     */
+    size_t event_ring_len;
+    /** the amount of latest variable changes kept for ade_dialogue_ctx_changes_since, 0 for a default of 32 */
+    size_t change_log_capacity;
+    /**
+     * keep the texts and metadata of lines and replies in compressed blocks, which are decompressed
+     * into a small cache when stepping reaches them, for large dialogue files on memory constrained
+     * targets. Lines in the event ring then only have a speaker. Ignored when sharing a context
+     */
+    zigbool compress_text;
+    /** the amount of decompressed text blocks of about 8KiB kept with compress_text, 0 for a default of 4 */
+    size_t text_cache_blocks;
+} DialogueContextCreateOpts;
+
+/**
+ * Like ade_dialogue_ctx_create_json, but with all options in a struct
+ */
+DialogueContext* ade_dialogue_ctx_create_json_opts(
+    /** pointer to buffer with json */
+    const char* json_ptr,
+    /** length of buffer with json */
+    size_t json_len,
+    /** options for the created context */
+    const DialogueContextCreateOpts* opts,
+    /** diagnostic information about any errors that occurred during creation */
+    Diagnostic* const c_diagnostic
+);
+
+/**
+ * Create a DialogueContext that reuses the already compiled dialogues
+ * of another context instead of parsing the json again. The new context
+ * starts fresh, with its own variables, callbacks and dialogue positions.
+ * The source context must not be destroyed before the new one.
+ * Safe to call concurrently for the same source.
+ * The output encoding of the source is kept, and when it isn't utf8,
+ * so is its interpolation setting.
+ * if it failed, returns null and fills the Diagnostic pointer
+ * with information about why
+ */
+DialogueContext* ade_dialogue_ctx_create_shared(
+    /** the context whose compiled dialogues will be shared */
+    const DialogueContext* source,
+    /** options for the created context */
+    const DialogueContextCreateOpts* opts,
+    /** diagnostic information about any errors that occurred during creation */
+    Diagnostic* const c_diagnostic
+);
+
+/**
+ * hand any buffered trace bytes to the TraceSink of the context,
+ * which also happens when the context is destroyed
+ */
+void ade_dialogue_ctx_flush_trace(DialogueContext* ctx);
+
+/* the types of variables, whose indices are separate per type */
+enum VariableType {
+    VARIABLE_TYPE_BOOLEAN,
+    VARIABLE_TYPE_STRING,
+};
+
+/* a change to a variable, see ade_dialogue_ctx_changes_since */
+typedef struct VariableChange {
+    /* increases by one with every change to any variable of the context, starting at 1 */
+    uint64_t seq;
+    /* a value of type VariableType */
+    unsigned char type;
+    /* the index of the variable among the variables of its type, see ade_dialogue_ctx_get_variable_name */
+    usz index;
+    /* for booleans */
+    zigbool old_boolean;
+    zigbool new_boolean;
+    /* for strings, only valid until the next change to any variable */
+    StringSlice old_string;
+    StringSlice new_string;
+} VariableChange;
+
+/* the result of ade_dialogue_ctx_changes_since */
+typedef struct ChangesSince {
+    /* the amount of changes written */
+    size_t count;
+    /**
+     * whether some changes after the requested sequence number were already overwritten,
+     * in which case the dirty variables (see ade_dialogue_ctx_take_dirty_variables) are complete instead
+     */
+    zigbool missed;
+} ChangesSince;
+
+/** the sequence number of the context's latest variable change, 0 before any change */
+uint64_t ade_dialogue_ctx_latest_change_seq(const DialogueContext* ctx);
+
+/**
+ * write the variable changes after the sequence number seq into changes, oldest first.
+ * Writes which don't change a variable's value are not changes. If there are more changes than
+ * fit, call it again with the seq of the last change written
+ */
+void ade_dialogue_ctx_changes_since(
+    const DialogueContext* ctx,
+    uint64_t seq,
+    VariableChange* changes,
+    size_t changes_len,
+    ChangesSince* result
+);
+
+/**
+ * write the indices of the variables of a VariableType which changed since they were last taken,
+ * and clear their dirty flags. Returns how many were written, the rest stay dirty for the next call
+ */
+size_t ade_dialogue_ctx_take_dirty_variables(DialogueContext* ctx, unsigned char type, usz* indices, size_t indices_len);
+
+/** get the utf8 name of a variable by its index, returning false if there is no such variable */
+zigbool ade_dialogue_ctx_get_variable_name(const DialogueContext* ctx, unsigned char type, usz index, StringSlice* name);
+
+/* possible kinds of a DialogueEvent */
+enum DialogueEventTag {
+    DIALOGUE_EVENT_LINE,
+    DIALOGUE_EVENT_CALL,
+    DIALOGUE_EVENT_LOCK,
+    DIALOGUE_EVENT_UNLOCK,
+};
+
+/**
+ * something which happened while stepping, see ade_dialogue_ctx_drain_events.
+ * The strings are part of the compiled dialogue and live as long as the context
+ */
+typedef struct DialogueEvent {
+    /* a value of type DialogueEventTag, indicating which field of the union is active */
+    unsigned char tag;
+    usz dialogue_id;
+    /* the node which emitted the event */
+    usz node_index;
+    union {
+        /* the line as written in the dialogue, before interpolation */
+        Line line;
+        /* the name of the function which was called */
+        StringSlice call;
+        /* for lock and unlock, the name of the variable which was set */
+        StringSlice variable;
+    };
+} DialogueEvent;
+
+/**
+ * move up to events_len of the oldest events of a context created with an event_ring_len
+ * into events, returning how many were moved. May be called from another thread than the
+ * one stepping the context, but from only one thread at a time
+ */
+size_t ade_dialogue_ctx_drain_events(DialogueContext* ctx, DialogueEvent* events, size_t events_len);
+
+/** the amount of events dropped so far because the context's event ring was full */
+size_t ade_dialogue_ctx_dropped_events(const DialogueContext* ctx);
+
+/* resident bytes of a DialogueContext by category */
+typedef struct MemoryReport {
+    /* compiled nodes and their reply conditions, 0 for a context sharing another's nodes */
+    size_t nodes;
+    /* the dialogue file's strings and texts (compressed with compress_text), along with other small static data */
+    size_t text;
+    /* buffers of string variable values which don't fit inline */
+    size_t variables;
+    /* hash maps of variables, functions and labels, approximately */
+    size_t maps;
+    /* step result buffers, interpolated texts and decompressed text blocks */
+    size_t scratch;
+} MemoryReport;
+
+/** write the resident bytes of the context by category to the given report */
+void ade_dialogue_ctx_memory_report(const DialogueContext* ctx, MemoryReport* report);
+
 /** destroy a previously created DialogueContext */
 void ade_dialogue_ctx_destroy(DialogueContext* ctx);
 
@@ -161,13 +456,23 @@ void ade_dialogue_ctx_destroy(DialogueContext* ctx);
  * using the ade_dialogue_ctx_get_node_by_label function
  * and reset to that.
  */
-void ade_dialogue_ctx_reset(DialogueContext* ctx, usz dialogue_id, size_t node_index);
+void ade_dialogue_ctx_reset(DialogueContext* ctx, usz dialogue_id, usz node_index);
 
 /** if the dialogue is at a choice, reply with an option by its id */
 void ade_dialogue_ctx_reply(DialogueContext* ctx, usz dialogue_id, size_t reply_id);
 
+/**
+ * the amount of random draws a dialogue has made. Each dialogue draws from its own stream of
+ * the context's seed, so this count is all it takes to save and restore its upcoming draws,
+ * and stepping other dialogues doesn't change them. Resetting doesn't change it
+ */
+uint64_t ade_dialogue_ctx_get_random_draws(const DialogueContext* ctx, usz dialogue_id);
+
+/** continue a dialogue's random draws from a count returned by ade_dialogue_ctx_get_random_draws */
+void ade_dialogue_ctx_set_random_draws(DialogueContext* ctx, usz dialogue_id, uint64_t draws);
+
 /* get the id for a node from its label */
-size_t ade_dialogue_ctx_get_node_by_label(DialogueContext* ctx, usz dialogue_id, const char* label_ptr, size_t label_len);
+usz ade_dialogue_ctx_get_node_by_label(DialogueContext* ctx, usz dialogue_id, const char* label_ptr, size_t label_len);
 
 /* set a function pointer and pointer payload to call when an event is reached  */
 void ade_dialogue_ctx_set_callback(
@@ -224,12 +529,52 @@ void ade_dialogue_ctx_set_variable_string(
     size_t value_len
 );
 
+/** the value of a boolean variable */
+zigbool ade_dialogue_ctx_get_variable_boolean(DialogueContext* ctx, const char* name, size_t name_len);
+
+/**
+ * the utf8 value of a string variable, only valid until the variable is next set,
+ * or for a variable bound to a world state, until the next get of a string variable
+ */
+void ade_dialogue_ctx_get_variable_string(DialogueContext* ctx, const char* name, size_t name_len, StringSlice* value);
+
 /**
  * Step to the next state for the given dialogue within the DialogueContext
  * See the StepResult type for possible states.
  */
 void ade_dialogue_ctx_step(DialogueContext* ctx, usz dialogue_id, StepResult* return_val);
 
+/* the result returned from calling ade_dialogue_ctx_advance */
+typedef struct AdvanceResult {
+    /* the number of lines written to the caller's buffer */
+    size_t line_count;
+    /* the step which ended the batch, one of STEP_RESULT_OPTIONS, STEP_RESULT_FUNCTION_CALLED or STEP_RESULT_DONE.
+     * If the buffer filled up first, it is STEP_RESULT_LINE with no data, and advance can be called again */
+    StepResult end;
+} AdvanceResult;
+
+/**
+ * Step the given dialogue until the next reply, function call or end, writing every line on the way
+ * into the caller's buffer of lines_len lines, so the whole batch is returned in one call.
+ * With interpolation, the lines are valid until the next step, advance or peek.
+ */
+void ade_dialogue_ctx_advance(
+    DialogueContext* ctx,
+    usz dialogue_id,
+    Line* lines,
+    size_t lines_len,
+    AdvanceResult* return_val
+);
+
+/**
+ * Write up to lines_len upcoming lines of the given dialogue into the caller's buffer without advancing it,
+ * e.g. to prefetch voice lines. Stops early at reply and function call nodes, and follows random
+ * switches to the branch their next draw will take, without drawing.
+ * With interpolation, the lines are valid until the next step, advance or peek.
+ * Returns the number of lines written.
+ */
+size_t ade_dialogue_ctx_peek(DialogueContext* ctx, usz dialogue_id, Line* lines, size_t lines_len);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,338 @@
+#ifndef LIB_ALTERNIS_HPP
+#define LIB_ALTERNIS_HPP
+
+// C++17 wrapper over alternis.h, header only. Everything here is inline and
+// non-owning views point straight into the context's memory, so nothing is copied.
+// Views of a step are valid until the next step, advance or peek of the same context.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "alternis.h"
+
+namespace alternis {
+
+/** a view of contiguous elements, like C++20 std::span */
+template <typename T>
+class span {
+public:
+    constexpr span() noexcept = default;
+    constexpr span(T* data, size_t size) noexcept : data_(size == 0 ? nullptr : data), size_(size) {}
+    template <size_t N>
+    constexpr span(T (&array)[N]) noexcept : data_(array), size_(N) {}
+
+    constexpr T* data() const noexcept { return data_; }
+    constexpr size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T& operator[](size_t index) const noexcept { return data_[index]; }
+    constexpr T* begin() const noexcept { return data_; }
+    constexpr T* end() const noexcept { return data_ + size_; }
+    constexpr span first(size_t count) const noexcept { return span(data_, count); }
+
+private:
+    T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/** the bytes of a string from the context, in its output encoding */
+inline std::string_view view(const StringSlice& slice) noexcept {
+    // ptr is undefined if len is 0
+    return slice.len == 0 ? std::string_view() : std::string_view(slice.ptr, slice.len);
+}
+
+/** for contexts created with TEXT_ENCODING_UTF16, the code units of a string */
+inline std::u16string_view as_utf16(std::string_view bytes) noexcept {
+    return std::u16string_view(reinterpret_cast<const char16_t*>(bytes.data()), bytes.size() / sizeof(char16_t));
+}
+
+/**
+ * a view of a line, holding a copy of its slices so it may outlive the Step or buffer it came from.
+ * The texts are not copied, they are valid for as long as the context keeps them
+ */
+class LineView {
+public:
+    explicit LineView(const ::Line& line) noexcept : line_(line) {}
+
+    std::string_view speaker() const noexcept { return view(line_.speaker); }
+    std::string_view text() const noexcept { return view(line_.text); }
+    bool has_metadata() const noexcept { return line_.metadata.ptr != nullptr; }
+    /** empty if the line has no metadata */
+    std::string_view metadata() const noexcept { return has_metadata() ? view(line_.metadata) : std::string_view(); }
+
+    const ::Line& raw() const noexcept { return line_; }
+
+private:
+    ::Line line_;
+};
+
+/** a view of lines, iterating as LineViews */
+class LineSpan {
+public:
+    class iterator {
+    public:
+        explicit iterator(const ::Line* line) noexcept : line_(line) {}
+        LineView operator*() const noexcept { return LineView(*line_); }
+        iterator& operator++() noexcept { ++line_; return *this; }
+        bool operator==(const iterator& other) const noexcept { return line_ == other.line_; }
+        bool operator!=(const iterator& other) const noexcept { return line_ != other.line_; }
+
+    private:
+        const ::Line* line_;
+    };
+
+    LineSpan() noexcept = default;
+    explicit LineSpan(span<const ::Line> lines) noexcept : lines_(lines) {}
+
+    size_t size() const noexcept { return lines_.size(); }
+    bool empty() const noexcept { return lines_.empty(); }
+    LineView operator[](size_t index) const noexcept { return LineView(lines_[index]); }
+    iterator begin() const noexcept { return iterator(lines_.begin()); }
+    iterator end() const noexcept { return iterator(lines_.end()); }
+
+    span<const ::Line> raw() const noexcept { return lines_; }
+
+private:
+    span<const ::Line> lines_;
+};
+
+/** the options of a reply, where ids[i] is the id to reply with for texts[i] */
+struct Options {
+    LineSpan texts;
+    span<const size_t> ids;
+
+    size_t size() const noexcept { return ids.size(); }
+};
+
+/** the states of a step, passed to the visitor of Step::visit */
+struct Done {};
+struct FunctionCalled {};
+
+/** the result of a step, see StepResult */
+class Step {
+public:
+    enum class Tag : unsigned char {
+        done = STEP_RESULT_DONE,
+        options = STEP_RESULT_OPTIONS,
+        line = STEP_RESULT_LINE,
+        function_called = STEP_RESULT_FUNCTION_CALLED,
+    };
+
+    explicit Step(const ::StepResult& result) noexcept : result_(result) {}
+
+    Tag tag() const noexcept { return static_cast<Tag>(result_.tag); }
+    bool is_done() const noexcept { return tag() == Tag::done; }
+
+    /** only valid if the tag is line */
+    LineView line() const noexcept { return LineView(result_.line); }
+
+    /** only valid if the tag is options */
+    Options options() const noexcept {
+        return Options{
+            LineSpan(span<const ::Line>(result_.options.texts.ptr, result_.options.texts.len)),
+            span<const size_t>(result_.options.ids.ptr, result_.options.ids.len),
+        };
+    }
+
+    /** call the visitor with one of Done, Options, LineView or FunctionCalled, returning its result */
+    template <typename Visitor>
+    decltype(auto) visit(Visitor&& visitor) const {
+        switch (tag()) {
+            case Tag::options: return std::forward<Visitor>(visitor)(options());
+            case Tag::line: return std::forward<Visitor>(visitor)(line());
+            case Tag::function_called: return std::forward<Visitor>(visitor)(FunctionCalled{});
+            case Tag::done: default: return std::forward<Visitor>(visitor)(Done{});
+        }
+    }
+
+    const ::StepResult& raw() const noexcept { return result_; }
+
+private:
+    // a copy of the C result, which itself only points into the context
+    ::StepResult result_;
+};
+
+/** the result of Context::advance */
+struct Advance {
+    /** the lines written to the buffer */
+    LineSpan lines;
+    /** the step which ended the batch, a line with no data if the buffer filled up first */
+    Step end;
+};
+
+/** a failure to create a context */
+struct Error {
+    DiagnosticErrors code = NoError;
+    std::string message;
+};
+
+/** owns a Diagnostic, destroying it once done */
+class ScopedDiagnostic {
+public:
+    ScopedDiagnostic() noexcept = default;
+    ScopedDiagnostic(const ScopedDiagnostic&) = delete;
+    ScopedDiagnostic& operator=(const ScopedDiagnostic&) = delete;
+    ~ScopedDiagnostic() { ade_diagnostic_destroy(&diagnostic_); }
+
+    Diagnostic* get() noexcept { return &diagnostic_; }
+
+    void to_error(Error* error) const {
+        if (error == nullptr) return;
+        error->code = static_cast<DiagnosticErrors>(diagnostic_.error_code);
+        error->message = std::string(view(diagnostic_.error_message));
+    }
+
+private:
+    Diagnostic diagnostic_{};
+};
+
+/** a move-only owner of a DialogueContext, which is destroyed with it */
+class Context {
+public:
+    Context() noexcept = default;
+    /** take ownership of a context from the C API */
+    explicit Context(DialogueContext* ctx) noexcept : ctx_(ctx) {}
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+    Context(Context&& other) noexcept : ctx_(other.release()) {}
+    Context& operator=(Context&& other) noexcept {
+        if (this != &other) reset_owned(other.release());
+        return *this;
+    }
+    ~Context() { reset_owned(nullptr); }
+
+    /** an empty Context if creating failed, with the reason in error if it isn't null */
+    static Context from_json(std::string_view json, const DialogueContextCreateOpts& opts = {}, Error* error = nullptr) {
+        ScopedDiagnostic diagnostic;
+        DialogueContext* ctx = ade_dialogue_ctx_create_json_opts(json.data(), json.size(), &opts, diagnostic.get());
+        if (ctx == nullptr) diagnostic.to_error(error);
+        return Context(ctx);
+    }
+
+    /** a context sharing this one's compiled dialogues, which must outlive it. See ade_dialogue_ctx_create_shared */
+    Context share(const DialogueContextCreateOpts& opts = {}, Error* error = nullptr) const {
+        ScopedDiagnostic diagnostic;
+        DialogueContext* ctx = ade_dialogue_ctx_create_shared(ctx_, &opts, diagnostic.get());
+        if (ctx == nullptr) diagnostic.to_error(error);
+        return Context(ctx);
+    }
+
+    explicit operator bool() const noexcept { return ctx_ != nullptr; }
+    DialogueContext* get() const noexcept { return ctx_; }
+    /** give up ownership of the context, which the caller must destroy */
+    DialogueContext* release() noexcept { return std::exchange(ctx_, nullptr); }
+
+    Step step(usz dialogue_id) {
+        ::StepResult result;
+        ade_dialogue_ctx_step(ctx_, dialogue_id, &result);
+        return Step(result);
+    }
+
+    /** step until a reply, function call or the end, writing the lines on the way into the buffer */
+    Advance advance(usz dialogue_id, span<::Line> buffer) {
+        ::AdvanceResult result;
+        ade_dialogue_ctx_advance(ctx_, dialogue_id, buffer.data(), buffer.size(), &result);
+        return Advance{ LineSpan(span<const ::Line>(buffer.data(), result.line_count)), Step(result.end) };
+    }
+
+    /** write the upcoming lines into the buffer without advancing, see ade_dialogue_ctx_peek */
+    LineSpan peek(usz dialogue_id, span<::Line> buffer) {
+        const size_t count = ade_dialogue_ctx_peek(ctx_, dialogue_id, buffer.data(), buffer.size());
+        return LineSpan(span<const ::Line>(buffer.data(), count));
+    }
+
+    void reset(usz dialogue_id, usz node_index = 0) { ade_dialogue_ctx_reset(ctx_, dialogue_id, node_index); }
+    void reply(usz dialogue_id, size_t reply_id) { ade_dialogue_ctx_reply(ctx_, dialogue_id, reply_id); }
+
+    /** see ade_dialogue_ctx_get_random_draws */
+    uint64_t random_draws(usz dialogue_id) const { return ade_dialogue_ctx_get_random_draws(ctx_, dialogue_id); }
+    void set_random_draws(usz dialogue_id, uint64_t draws) { ade_dialogue_ctx_set_random_draws(ctx_, dialogue_id, draws); }
+
+    usz node_by_label(usz dialogue_id, std::string_view label) {
+        return ade_dialogue_ctx_get_node_by_label(ctx_, dialogue_id, label.data(), label.size());
+    }
+
+    void set_boolean(std::string_view name, bool value) {
+        ade_dialogue_ctx_set_variable_boolean(ctx_, name.data(), name.size(), value);
+    }
+
+    /** the value is copied */
+    void set_string(std::string_view name, std::string_view value) {
+        ade_dialogue_ctx_set_variable_string(ctx_, name.data(), name.size(), value.data(), value.size());
+    }
+
+    /** the payload must outlive the context */
+    void set_callback(std::string_view name, void (*callback)(void*), void* payload) {
+        ade_dialogue_ctx_set_callback(ctx_, name.data(), name.size(), callback, payload);
+    }
+
+    void set_all_callbacks(void (*callback)(SetAllCallbacksPayload*), void* payload) {
+        ade_dialogue_ctx_set_all_callbacks(ctx_, callback, payload);
+    }
+
+    /** may be called on another thread than the one stepping, see ade_dialogue_ctx_drain_events */
+    span<const DialogueEvent> drain_events(span<DialogueEvent> buffer) {
+        const size_t count = ade_dialogue_ctx_drain_events(ctx_, buffer.data(), buffer.size());
+        return span<const DialogueEvent>(buffer.data(), count);
+    }
+
+    size_t dropped_events() const { return ade_dialogue_ctx_dropped_events(ctx_); }
+
+    bool get_boolean(std::string_view name) {
+        return ade_dialogue_ctx_get_variable_boolean(ctx_, name.data(), name.size());
+    }
+
+    /** valid until the variable is next set, or the next get_string if it is bound to a world state */
+    std::string_view get_string(std::string_view name) {
+        StringSlice value{};
+        ade_dialogue_ctx_get_variable_string(ctx_, name.data(), name.size(), &value);
+        return view(value);
+    }
+
+    uint64_t latest_change_seq() const { return ade_dialogue_ctx_latest_change_seq(ctx_); }
+
+    /** the changes after seq which fit in the buffer, see ade_dialogue_ctx_changes_since */
+    span<const VariableChange> changes_since(uint64_t seq, span<VariableChange> buffer, bool* missed = nullptr) const {
+        ChangesSince result{};
+        ade_dialogue_ctx_changes_since(ctx_, seq, buffer.data(), buffer.size(), &result);
+        if (missed != nullptr) *missed = result.missed;
+        return span<const VariableChange>(buffer.data(), result.count);
+    }
+
+    span<const usz> take_dirty_variables(VariableType type, span<usz> buffer) {
+        const size_t count = ade_dialogue_ctx_take_dirty_variables(ctx_, type, buffer.data(), buffer.size());
+        return span<const usz>(buffer.data(), count);
+    }
+
+    /** empty if there is no such variable */
+    std::string_view variable_name(VariableType type, usz index) const {
+        StringSlice name{};
+        if (!ade_dialogue_ctx_get_variable_name(ctx_, type, index, &name)) return std::string_view();
+        return view(name);
+    }
+
+    MemoryReport memory_report() const {
+        MemoryReport report;
+        ade_dialogue_ctx_memory_report(ctx_, &report);
+        return report;
+    }
+
+    void flush_trace() { ade_dialogue_ctx_flush_trace(ctx_); }
+
+private:
+    void reset_owned(DialogueContext* ctx) noexcept {
+        if (ctx_ != nullptr) ade_dialogue_ctx_destroy(ctx_);
+        ctx_ = ctx;
+    }
+
+    DialogueContext* ctx_ = nullptr;
+};
+
+static_assert(sizeof(Context) == sizeof(DialogueContext*), "Context must be as cheap as the pointer it owns");
+
+} // namespace alternis
+
+#endif // LIB_ALTERNIS_HPP
@@ -0,0 +1,214 @@
+//! The recent changes to a context's variables, so that a host can keep its UI and save state in
+//! sync incrementally instead of mirroring every variable or polling all of them.
+//! Both writes by the host and lock/unlock nodes while stepping are recorded.
+//!
+//! Every change gets the next sequence number. The last `capacity` changes are kept in a ring
+//! whose slots reuse their string storage, so recording doesn't allocate once values fit.
+//! For hosts which only care about which variables changed, a dirty bit per variable is
+//! set on every change, until it is taken.
+//! NOTE: writes to a bound WorldState by anything other than this context are not recorded
+
+const std = @import("std");
+const usz = @import("./config.zig").usz;
+const Slice = @import("./slice.zig").Slice;
+const StringVariable = @import("./StringVariable.zig");
+
+pub const VariableType = enum(u8) {
+    boolean = 0,
+    string = 1,
+};
+
+pub const Change = extern struct {
+    /// the first change is 1, so that 0 means "before any change"
+    seq: u64,
+    type: VariableType,
+    /// the index of the variable among the context's variables of its type
+    index: usz,
+    old_boolean: bool = false,
+    new_boolean: bool = false,
+    /// only valid until the next change to any variable
+    old_string: Slice(u8) = .{},
+    new_string: Slice(u8) = .{},
+};
+
+pub const ChangesSince = extern struct {
+    /// the amount of changes written
+    count: usize,
+    /// whether some changes after the requested sequence were already overwritten, in which case
+    /// the host should resync from the dirty flags (or all variables) instead
+    missed: bool,
+};
+
+const Entry = struct {
+    seq: u64 = 0,
+    type: VariableType = .boolean,
+    index: usz = 0,
+    old_boolean: bool = false,
+    new_boolean: bool = false,
+    old_string: StringVariable = .{},
+    new_string: StringVariable = .{},
+};
+
+/// a ring of the latest changes, the change with sequence number s is at s % entries.len
+entries: []Entry,
+/// the sequence number of the latest change
+seq: u64 = 0,
+dirty_booleans: std.DynamicBitSetUnmanaged,
+dirty_strings: std.DynamicBitSetUnmanaged,
+
+const Self = @This();
+
+/// a capacity of 0 keeps no changes, only the dirty flags and sequence number
+pub fn init(alloc: std.mem.Allocator, capacity: usize, boolean_count: usize, string_count: usize) !Self {
+    const entries = try alloc.alloc(Entry, capacity);
+    errdefer alloc.free(entries);
+    for (entries) |*entry| entry.* = .{};
+
+    var dirty_booleans = try std.DynamicBitSetUnmanaged.initEmpty(alloc, boolean_count);
+    errdefer dirty_booleans.deinit(alloc);
+    const dirty_strings = try std.DynamicBitSetUnmanaged.initEmpty(alloc, string_count);
+
+    return .{ .entries = entries, .dirty_booleans = dirty_booleans, .dirty_strings = dirty_strings };
+}
+
+pub fn deinit(self: *Self, alloc: std.mem.Allocator) void {
+    for (self.entries) |*entry| {
+        entry.old_string.deinit(alloc);
+        entry.new_string.deinit(alloc);
+    }
+    alloc.free(self.entries);
+    self.dirty_booleans.deinit(alloc);
+    self.dirty_strings.deinit(alloc);
+}
+
+fn next(self: *Self, var_type: VariableType, index: usz) ?*Entry {
+    self.seq += 1;
+    switch (var_type) {
+        .boolean => self.dirty_booleans.set(index),
+        .string => self.dirty_strings.set(index),
+    }
+    if (self.entries.len == 0) return null;
+    const entry = &self.entries[@intCast(self.seq % self.entries.len)];
+    entry.seq = self.seq;
+    entry.type = var_type;
+    entry.index = index;
+    return entry;
+}
+
+/// writes which don't change the value aren't recorded
+pub fn recordBoolean(self: *Self, index: usz, old: bool, new: bool) void {
+    if (old == new) return;
+    const entry = self.next(.boolean, index) orelse return;
+    entry.old_boolean = old;
+    entry.new_boolean = new;
+}
+
+/// the values are copied. Writes which don't change the value aren't recorded
+pub fn recordString(self: *Self, alloc: std.mem.Allocator, index: usz, old: []const u8, new: []const u8) std.mem.Allocator.Error!void {
+    if (std.mem.eql(u8, old, new)) return;
+    const entry = self.next(.string, index) orelse return;
+    try entry.old_string.set(alloc, old);
+    try entry.new_string.set(alloc, new);
+}
+
+/// write the changes after the sequence number `seq` into `out`, oldest first.
+/// If out is too short, call it again from the sequence number of the last change written
+pub fn changesSince(self: *const Self, seq: u64, out: []Change) ChangesSince {
+    const oldest_kept = self.seq -| self.entries.len;
+    const from = @max(seq, oldest_kept);
+    const count: usize = @intCast(@min(self.seq -| from, out.len));
+
+    for (out[0..count], 0..) |*change, i| {
+        const change_seq = from + 1 + i;
+        const entry = &self.entries[@intCast(change_seq % self.entries.len)];
+        std.debug.assert(entry.seq == change_seq);
+        change.* = .{ .seq = entry.seq, .type = entry.type, .index = entry.index };
+        switch (entry.type) {
+            .boolean => {
+                change.old_boolean = entry.old_boolean;
+                change.new_boolean = entry.new_boolean;
+            },
+            .string => {
+                change.old_string = Slice(u8).fromZig(entry.old_string.slice());
+                change.new_string = Slice(u8).fromZig(entry.new_string.slice());
+            },
+        }
+    }
+
+    return .{ .count = count, .missed = seq < oldest_kept };
+}
+
+/// write the indices of the dirty variables of a type into `out` and clear their dirty flags,
+/// returning how many were written. If out is too short, the rest stay dirty for the next call
+pub fn takeDirty(self: *Self, var_type: VariableType, out: []usz) usize {
+    const dirty = switch (var_type) {
+        .boolean => &self.dirty_booleans,
+        .string => &self.dirty_strings,
+    };
+    var count: usize = 0;
+    var iter = dirty.iterator(.{});
+    while (count < out.len) : (count += 1) {
+        const index = iter.next() orelse break;
+        out[count] = @intCast(index);
+    }
+    for (out[0..count]) |index| dirty.unset(index);
+    return count;
+}
+
+/// heap bytes held by the log
+pub fn residentBytes(self: *const Self) usize {
+    var result = self.entries.len * @sizeOf(Entry) +
+        (self.dirty_booleans.bit_length + self.dirty_strings.bit_length + 2 * @bitSizeOf(usize)) / 8;
+    for (self.entries) |entry| result += entry.old_string.residentBytes() + entry.new_string.residentBytes();
+    return result;
+}
+
+const t = std.testing;
+
+test "changes since a sequence number" {
+    var log = try init(t.allocator, 4, 3, 1);
+    defer log.deinit(t.allocator);
+
+    log.recordBoolean(0, false, true);
+    log.recordBoolean(1, false, false); // unchanged
+    try log.recordString(t.allocator, 0, "<UNSET>", "Testy McTester of the Testing Realm");
+    try t.expectEqual(@as(u64, 2), log.seq);
+
+    var out: [8]Change = undefined;
+    {
+        const result = log.changesSince(0, &out);
+        try t.expectEqual(@as(usize, 2), result.count);
+        try t.expect(!result.missed);
+        try t.expectEqual(VariableType.boolean, out[0].type);
+        try t.expect(out[0].new_boolean);
+        try t.expectEqual(@as(u64, 2), out[1].seq);
+        try t.expectEqualStrings("<UNSET>", out[1].old_string.toZig());
+        try t.expectEqualStrings("Testy McTester of the Testing Realm", out[1].new_string.toZig());
+    }
+
+    try t.expectEqual(@as(usize, 0), log.changesSince(2, &out).count);
+
+    // wrap around the ring
+    for (0..5) |i| log.recordBoolean(2, i % 2 == 1, i % 2 == 0);
+    {
+        const result = log.changesSince(1, &out);
+        try t.expect(result.missed);
+        try t.expectEqual(@as(usize, 4), result.count);
+        try t.expectEqual(@as(u64, 4), out[0].seq);
+        try t.expectEqual(@as(u64, 7), out[3].seq);
+    }
+    {
+        const result = log.changesSince(5, out[0..1]);
+        try t.expect(!result.missed);
+        try t.expectEqual(@as(usize, 1), result.count);
+        try t.expectEqual(@as(u64, 6), out[0].seq);
+    }
+
+    var dirty: [1]usz = undefined;
+    try t.expectEqual(@as(usize, 1), log.takeDirty(.boolean, &dirty));
+    try t.expectEqual(@as(usz, 0), dirty[0]);
+    try t.expectEqual(@as(usize, 1), log.takeDirty(.boolean, &dirty));
+    try t.expectEqual(@as(usz, 2), dirty[0]);
+    try t.expectEqual(@as(usize, 0), log.takeDirty(.boolean, &dirty));
+    try t.expectEqual(@as(usize, 1), log.takeDirty(.string, &dirty));
+}
@@ -0,0 +1,166 @@
+//! A lock-free single-producer/single-consumer ring of fixed-size events, through which a
+//! context tells the host about what happened while stepping (lines, calls, lock/unlock)
+//! instead of calling back into it. The context steps on one thread and pushes, and the host
+//! drains batches on another, so the dialogue can tick on a worker thread without ever
+//! running host code. @see DialogueContext.InitOpts.events
+//!
+//! The ring never blocks or allocates: when it is full, events are dropped and counted,
+//! so size it for the most events the host may let pile up between drains.
+
+const std = @import("std");
+const usz = @import("./config.zig").usz;
+const Slice = @import("./slice.zig").Slice;
+const Line = @import("./main.zig").Line;
+
+pub const Event = extern struct {
+    tag: Tag,
+    dialogue_id: usz,
+    /// the node which emitted the event
+    node_index: usz,
+    data: Data,
+
+    /// every string is part of the compiled dialogue, so it stays valid for the lifetime of
+    /// the context and may be read from any thread
+    pub const Data = extern union {
+        /// the line as written in the dialogue before interpolation, in the output encoding unless
+        /// the context interpolates, which keeps texts utf8 until they are interpolated.
+        /// With compressed texts only the speaker is set, @see DialogueContext.InitOpts.compress_text
+        line: Line,
+        /// the name of the function a call node called
+        call: Slice(u8),
+        /// for lock and unlock, the name of the variable which was set
+        variable: Slice(u8),
+    };
+
+    pub const Tag = enum(u8) {
+        line = 0,
+        call = 1,
+        lock = 2,
+        unlock = 3,
+    };
+};
+
+/// slots, whose length is a power of two so that indices wrap with a mask
+buffer: []Event,
+
+// the producer and consumer each write their own index on their own cache line, and keep
+// a stale copy of the other's index, so the shared lines are only touched when the copy
+// says the ring looks full (or empty)
+
+/// written by the producer, the index of the next slot to push into
+tail: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+head_cache: usize = 0,
+/// written by the producer, the amount of events dropped because the ring was full
+dropped: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+
+/// written by the consumer, the index of the next slot to drain
+head: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+tail_cache: usize = 0,
+
+const Self = @This();
+
+/// the buffer must outlive the ring, and its length must be a power of two
+pub fn init(buffer: []Event) Self {
+    std.debug.assert(std.math.isPowerOfTwo(buffer.len));
+    return .{ .buffer = buffer };
+}
+
+/// the producer side, returns false and counts the event as dropped if the ring is full
+pub fn push(self: *Self, event: Event) bool {
+    const tail = self.tail.raw;
+    if (tail -% self.head_cache == self.buffer.len) {
+        self.head_cache = self.head.load(.acquire);
+        if (tail -% self.head_cache == self.buffer.len) {
+            _ = self.dropped.fetchAdd(1, .monotonic);
+            return false;
+        }
+    }
+    self.buffer[tail & (self.buffer.len - 1)] = event;
+    // publish the slot before the index which makes it visible
+    self.tail.store(tail +% 1, .release);
+    return true;
+}
+
+/// the consumer side, moves up to out.len of the oldest events into out and returns how many
+pub fn drain(self: *Self, out: []Event) usize {
+    const head = self.head.raw;
+    if (self.tail_cache -% head < out.len)
+        self.tail_cache = self.tail.load(.acquire);
+
+    const count = @min(self.tail_cache -% head, out.len);
+    for (out[0..count], 0..) |*event, i|
+        event.* = self.buffer[(head +% i) & (self.buffer.len - 1)];
+    // release the slots only after they were read
+    self.head.store(head +% count, .release);
+    return count;
+}
+
+/// the amount of events dropped so far, may be read from either side
+pub fn droppedCount(self: *const Self) usize {
+    return self.dropped.load(.monotonic);
+}
+
+const t = std.testing;
+
+fn callEvent(index: usize) Event {
+    return .{ .tag = .call, .dialogue_id = 0, .node_index = @intCast(index), .data = .{ .call = Slice(u8).fromZig("f") } };
+}
+
+test "push and drain wrap around and drop when full" {
+    var buffer: [4]Event = undefined;
+    var ring = init(&buffer);
+    var out: [8]Event = undefined;
+
+    var pushed: usize = 0;
+    var drained: usize = 0;
+    for (0..5) |_| {
+        for (0..3) |_| {
+            try t.expect(ring.push(callEvent(pushed)));
+            pushed += 1;
+        }
+        const count = ring.drain(&out);
+        try t.expectEqual(@as(usize, 3), count);
+        for (out[0..count]) |event| {
+            try t.expectEqual(@as(usz, @intCast(drained)), event.node_index);
+            drained += 1;
+        }
+    }
+
+    for (0..4) |i| try t.expect(ring.push(callEvent(i)));
+    try t.expect(!ring.push(callEvent(4)));
+    try t.expectEqual(@as(usize, 1), ring.droppedCount());
+    // a short out buffer leaves the rest for the next drain
+    try t.expectEqual(@as(usize, 3), ring.drain(out[0..3]));
+    try t.expectEqual(@as(usize, 1), ring.drain(&out));
+    try t.expectEqual(@as(usize, 0), ring.drain(&out));
+}
+
+test "events arrive in order across threads" {
+    if (@import("builtin").single_threaded) return error.SkipZigTest;
+
+    var buffer: [64]Event = undefined;
+    var ring = init(&buffer);
+    const total = 100_000;
+
+    const Producer = struct {
+        fn run(r: *Self) void {
+            var i: usize = 0;
+            while (i < total) {
+                if (r.push(callEvent(i))) i += 1 else std.Thread.yield() catch {};
+            }
+        }
+    };
+
+    const producer = try std.Thread.spawn(.{}, Producer.run, .{&ring});
+
+    var out: [16]Event = undefined;
+    var next: usize = 0;
+    while (next < total) {
+        for (out[0..ring.drain(&out)]) |event| {
+            try t.expectEqual(@as(usz, @intCast(next)), event.node_index);
+            next += 1;
+        }
+    }
+    producer.join();
+    try t.expectEqual(@as(usize, 0), ring.drain(&out));
+}
@@ -0,0 +1,158 @@
+//! An allocator pooling small allocations into power of two size classes, carved from
+//! slabs of the backing allocator. A context makes many small, short lived allocations
+//! (interpolated texts and their chunk lists, option lines, conditions, hash map buckets),
+//! which this serves from free lists, and lets grow in place within their size class.
+//! Larger allocations (e.g. arena buffers) go directly to the backing allocator.
+//! Not thread safe, it is meant to be owned by one context.
+
+const std = @import("std");
+
+/// the smallest class must fit a free list link, and 16 bytes is the largest pooled alignment
+const min_class_log2 = 4;
+/// interpolation writes 512 byte chunks, so the largest class fits those with room to spare
+const max_class_log2 = 10;
+const class_count = max_class_log2 - min_class_log2 + 1;
+
+const slab_len = 16 * 1024;
+/// space at the start of each slab for the link to the next one, keeping blocks 16 byte aligned
+const slab_header_len = 1 << min_class_log2;
+
+const FreeBlock = struct { next: ?*FreeBlock };
+const Slab = struct { next: ?*Slab };
+
+backing: std.mem.Allocator,
+free_lists: [class_count]?*FreeBlock = .{null} ** class_count,
+/// each class carves blocks from its own current slab
+slab_cursors: [class_count][*]u8 = undefined,
+slab_remaining: [class_count]usize = .{0} ** class_count,
+slabs: ?*Slab = null,
+
+const Self = @This();
+
+pub fn init(backing: std.mem.Allocator) Self {
+    return Self{ .backing = backing };
+}
+
+/// frees every slab, and therefore every pooled allocation, at once
+pub fn deinit(self: *Self) void {
+    var maybe_slab = self.slabs;
+    while (maybe_slab) |slab| {
+        maybe_slab = slab.next;
+        const slab_bytes: [*]align(slab_header_len) u8 = @ptrCast(@alignCast(slab));
+        self.backing.free(slab_bytes[0..slab_len]);
+    }
+    self.* = undefined;
+}
+
+pub fn allocator(self: *Self) std.mem.Allocator {
+    return std.mem.Allocator{
+        .ptr = self,
+        .vtable = &vtable,
+    };
+}
+
+const vtable = std.mem.Allocator.VTable{
+    .alloc = _alloc,
+    .resize = _resize,
+    .free = _free,
+};
+
+/// null if the allocation is not pooled
+fn classIndex(len: usize, log2_align: u8) ?usize {
+    if (log2_align > min_class_log2) return null;
+    const class_log2 = std.math.log2_int_ceil(usize, @max(len, 1 << min_class_log2));
+    if (class_log2 > max_class_log2) return null;
+    return class_log2 - min_class_log2;
+}
+
+fn classLen(class: usize) usize {
+    return @as(usize, 1) << @intCast(class + min_class_log2);
+}
+
+fn _alloc(
+    _self: *anyopaque,
+    len: usize,
+    log2_ptr_align: u8,
+    ret_addr: usize,
+) ?[*]u8 {
+    const self: *Self = @alignCast(@ptrCast(_self));
+    const class = classIndex(len, log2_ptr_align) orelse return self.backing.rawAlloc(len, log2_ptr_align, ret_addr);
+
+    if (self.free_lists[class]) |block| {
+        self.free_lists[class] = block.next;
+        return @ptrCast(block);
+    }
+
+    const block_len = classLen(class);
+    if (self.slab_remaining[class] < block_len) {
+        const slab_bytes = self.backing.alignedAlloc(u8, slab_header_len, slab_len) catch return null;
+        const slab: *Slab = @ptrCast(slab_bytes.ptr);
+        slab.* = .{ .next = self.slabs };
+        self.slabs = slab;
+        // NOTE: any remainder of the previous slab is abandoned, it is at most one block short
+        self.slab_cursors[class] = slab_bytes.ptr + slab_header_len;
+        self.slab_remaining[class] = slab_len - slab_header_len;
+    }
+
+    const block = self.slab_cursors[class];
+    self.slab_cursors[class] += block_len;
+    self.slab_remaining[class] -= block_len;
+    return block;
+}
+
+fn _resize(
+    _self: *anyopaque,
+    buf: []u8,
+    log2_buf_align: u8,
+    new_len: usize,
+    ret_addr: usize,
+) bool {
+    const self: *Self = @alignCast(@ptrCast(_self));
+    const old_class = classIndex(buf.len, log2_buf_align);
+    const new_class = classIndex(new_len, log2_buf_align);
+
+    if (old_class == null and new_class == null)
+        return self.backing.rawResize(buf, log2_buf_align, new_len, ret_addr);
+
+    // a pooled block may grow or shrink freely within its class
+    return old_class != null and new_class != null and old_class.? == new_class.?;
+}
+
+fn _free(
+    _self: *anyopaque,
+    buf: []u8,
+    log2_buf_align: u8,
+    ret_addr: usize,
+) void {
+    const self: *Self = @alignCast(@ptrCast(_self));
+    const class = classIndex(buf.len, log2_buf_align) orelse return self.backing.rawFree(buf, log2_buf_align, ret_addr);
+
+    const block: *FreeBlock = @ptrCast(@alignCast(buf.ptr));
+    block.* = .{ .next = self.free_lists[class] };
+    self.free_lists[class] = block;
+}
+
+const t = std.testing;
+
+test "pool allocator" {
+    var pool = Self.init(t.allocator);
+    defer pool.deinit();
+    const pool_alloc = pool.allocator();
+
+    try std.heap.testAllocator(pool_alloc);
+
+    const first = try pool_alloc.alloc(u8, 40);
+    // grows in place within the 64 byte class
+    try t.expect(pool_alloc.resize(first, 64));
+    try t.expect(!pool_alloc.resize(first, 65));
+    pool_alloc.free(first.ptr[0..64]);
+
+    // freed blocks are reused
+    const second = try pool_alloc.alloc(u8, 50);
+    try t.expectEqual(first.ptr, second.ptr);
+    pool_alloc.free(second);
+
+    // large allocations are passed through
+    const large = try pool_alloc.alloc(u8, 4096);
+    pool_alloc.free(large);
+}
@@ -0,0 +1,82 @@
+//! The value of a string variable. Its buffer is reused across sets and only grows, so that
+//! variables which are set often (timers, counters, names) don't allocate on every set.
+//! Values of up to `inline_capacity` bytes are stored inline, without a buffer
+
+const std = @import("std");
+
+pub const inline_capacity = 22;
+
+/// for values longer than inline_capacity, its length is the capacity
+buffer: []u8 = &.{},
+len: usize = 0,
+small: [inline_capacity]u8 = [_]u8{0} ** inline_capacity,
+
+/// the value of a variable which hasn't been set
+pub const unset = fromInline("<UNSET>");
+
+fn fromInline(comptime value: []const u8) @This() {
+    comptime std.debug.assert(value.len <= inline_capacity);
+    var result = @This(){ .len = value.len };
+    @memcpy(result.small[0..value.len], value);
+    return result;
+}
+
+/// invalidated by the next set
+pub fn slice(self: *const @This()) []const u8 {
+    return if (self.len <= inline_capacity) self.small[0..self.len] else self.buffer[0..self.len];
+}
+
+/// copies the value, which may be the current value
+pub fn set(self: *@This(), alloc: std.mem.Allocator, value: []const u8) std.mem.Allocator.Error!void {
+    if (value.len <= inline_capacity) {
+        std.mem.copyForwards(u8, self.small[0..value.len], value);
+    } else {
+        // a value aliasing the buffer always fits in it
+        if (value.len > self.buffer.len) {
+            // grow geometrically, so that a value growing a bit per set doesn't allocate per set
+            const new_buffer = try alloc.alloc(u8, @max(value.len, self.buffer.len * 2));
+            alloc.free(self.buffer);
+            self.buffer = new_buffer;
+        }
+        std.mem.copyForwards(u8, self.buffer[0..value.len], value);
+    }
+    self.len = value.len;
+}
+
+/// heap bytes held by the variable, excluding the inline storage
+pub fn residentBytes(self: @This()) usize {
+    return self.buffer.len;
+}
+
+pub fn deinit(self: *@This(), alloc: std.mem.Allocator) void {
+    alloc.free(self.buffer);
+    self.* = unset;
+}
+
+const t = std.testing;
+
+test {
+    var variable = unset;
+    defer variable.deinit(t.allocator);
+    try t.expectEqualStrings("<UNSET>", variable.slice());
+
+    try variable.set(t.allocator, "Testy");
+    try t.expectEqualStrings("Testy", variable.slice());
+    try t.expectEqual(@as(usize, 0), variable.residentBytes());
+
+    try variable.set(t.allocator, "Testy McTester of the Testing Realm");
+    try t.expectEqualStrings("Testy McTester of the Testing Realm", variable.slice());
+    const buffer = variable.buffer;
+
+    // shorter long values and inline values reuse what's there
+    try variable.set(t.allocator, "Testy McTester the Second");
+    try t.expectEqualStrings("Testy McTester the Second", variable.slice());
+    try variable.set(t.allocator, "Testy");
+    try t.expectEqualStrings("Testy", variable.slice());
+    try variable.set(t.allocator, "Testy McTester of the Testing Realm");
+    try t.expectEqual(buffer.ptr, variable.buffer.ptr);
+
+    // the current value may be set again
+    try variable.set(t.allocator, variable.slice()[6..]);
+    try t.expectEqualStrings("McTester of the Testing Realm", variable.slice());
+}
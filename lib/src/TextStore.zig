@@ -0,0 +1,210 @@
+//! The texts of a dialogue file kept in compressed blocks, so that large projects stay resident
+//! at a fraction of their raw text size while only the few texts being displayed are decompressed.
+//!
+//! Texts are appended into blocks of about `block_size` bytes, each compressed with lz.zig once
+//! full, and a text never straddles two blocks. The store is immutable once built, so contexts
+//! sharing compiled dialogues share it too, and each decompresses what it reads into its own
+//! small Cache. @see DialogueContext.InitOpts.compress_text
+
+const std = @import("std");
+const lz = @import("./lz.zig");
+
+/// where a text is in the store
+pub const Ref = extern struct {
+    block: u32 = none_block,
+    offset: u32 = 0,
+    len: u32 = 0,
+
+    const none_block = std.math.maxInt(u32);
+
+    /// for an absent text, e.g. the metadata of a line without any
+    pub const none = Ref{};
+
+    pub fn isNone(self: Ref) bool {
+        return self.block == none_block;
+    }
+};
+
+const Block = struct {
+    /// the start of the compressed block in `bytes`
+    start: u32,
+    len: u32,
+    raw_len: u32,
+};
+
+pub const default_block_size = 8 * 1024;
+
+blocks: []const Block = &.{},
+/// every compressed block, back to back
+bytes: []const u8 = &.{},
+/// the length of all texts before compression
+raw_len: usize = 0,
+
+const Self = @This();
+
+pub const Builder = struct {
+    alloc: std.mem.Allocator,
+    block_size: usize,
+    /// the texts of the block being filled
+    pending: std.ArrayListUnmanaged(u8) = .{},
+    bytes: std.ArrayListUnmanaged(u8) = .{},
+    blocks: std.ArrayListUnmanaged(Block) = .{},
+    raw_len: usize = 0,
+
+    pub fn init(alloc: std.mem.Allocator, block_size: usize) Builder {
+        return .{ .alloc = alloc, .block_size = block_size };
+    }
+
+    pub fn deinit(self: *Builder) void {
+        self.pending.deinit(self.alloc);
+        self.bytes.deinit(self.alloc);
+        self.blocks.deinit(self.alloc);
+    }
+
+    /// copy a text into the store. A text longer than the block size gets a block of its own
+    pub fn add(self: *Builder, text: []const u8) !Ref {
+        if (text.len == 0) return .{ .block = 0, .len = 0 };
+        if (self.pending.items.len > 0 and self.pending.items.len + text.len > self.block_size)
+            try self.flush();
+
+        const ref = Ref{
+            .block = @intCast(self.blocks.items.len),
+            .offset = @intCast(self.pending.items.len),
+            .len = @intCast(text.len),
+        };
+        try self.pending.appendSlice(self.alloc, text);
+        self.raw_len += text.len;
+        return ref;
+    }
+
+    fn flush(self: *Builder) !void {
+        if (self.pending.items.len == 0) return;
+        try self.bytes.ensureUnusedCapacity(self.alloc, lz.compressBound(self.pending.items.len));
+        try self.blocks.ensureUnusedCapacity(self.alloc, 1);
+
+        const len = lz.compress(self.pending.items, self.bytes.unusedCapacitySlice());
+        self.blocks.appendAssumeCapacity(.{
+            .start = @intCast(self.bytes.items.len),
+            .len = @intCast(len),
+            .raw_len = @intCast(self.pending.items.len),
+        });
+        self.bytes.items.len += len;
+        self.pending.clearRetainingCapacity();
+    }
+
+    /// compress the last block and copy the store into `alloc`, e.g. an arena,
+    /// so that it is allocated at its exact size
+    pub fn finish(self: *Builder, alloc: std.mem.Allocator) !Self {
+        try self.flush();
+        return .{
+            .blocks = try alloc.dupe(Block, self.blocks.items),
+            .bytes = try alloc.dupe(u8, self.bytes.items),
+            .raw_len = self.raw_len,
+        };
+    }
+};
+
+/// resident bytes of the store
+pub fn residentBytes(self: *const Self) usize {
+    return self.blocks.len * @sizeOf(Block) + self.bytes.len;
+}
+
+/// the most recently used decompressed blocks of a store
+pub const Cache = struct {
+    slots: []Slot,
+    /// advanced on every lookup, to find the least recently used slot
+    clock: u64 = 0,
+
+    const Slot = struct {
+        block: u32 = Ref.none_block,
+        last_used: u64 = 0,
+        /// reused for every block decompressed into the slot
+        buffer: std.ArrayListUnmanaged(u8) = .{},
+    };
+
+    /// slot buffers are only allocated once a block is read
+    pub fn init(alloc: std.mem.Allocator, slot_count: usize) !Cache {
+        const slots = try alloc.alloc(Slot, slot_count);
+        for (slots) |*slot| slot.* = .{};
+        return .{ .slots = slots };
+    }
+
+    pub fn deinit(self: *Cache, alloc: std.mem.Allocator) void {
+        for (self.slots) |*slot| slot.buffer.deinit(alloc);
+        alloc.free(self.slots);
+    }
+
+    /// the text of a ref, decompressing its block over the least recently used one if it isn't cached.
+    /// Only valid until the next get, which may evict its block
+    pub fn get(self: *Cache, alloc: std.mem.Allocator, store: *const Self, ref: Ref) std.mem.Allocator.Error![]const u8 {
+        std.debug.assert(!ref.isNone());
+        if (ref.len == 0) return "";
+        std.debug.assert(self.slots.len > 0);
+
+        self.clock += 1;
+        var victim = &self.slots[0];
+        for (self.slots) |*slot| {
+            if (slot.block == ref.block) {
+                slot.last_used = self.clock;
+                return slot.buffer.items[ref.offset..][0..ref.len];
+            }
+            if (slot.last_used < victim.last_used) victim = slot;
+        }
+
+        const block = store.blocks[ref.block];
+        // left empty if growing the buffer fails
+        victim.block = Ref.none_block;
+        try victim.buffer.resize(alloc, block.raw_len);
+        // the block was compressed by the Builder, so it can't be corrupt
+        lz.decompress(store.bytes[block.start..][0..block.len], victim.buffer.items) catch unreachable;
+        victim.block = ref.block;
+        victim.last_used = self.clock;
+        return victim.buffer.items[ref.offset..][0..ref.len];
+    }
+
+    /// heap bytes held by the cache
+    pub fn residentBytes(self: *const Cache) usize {
+        var result = self.slots.len * @sizeOf(Slot);
+        for (self.slots) |slot| result += slot.buffer.capacity;
+        return result;
+    }
+};
+
+const t = std.testing;
+
+test "texts are read back through a cache smaller than the store" {
+    var builder = Builder.init(t.allocator, 64);
+    defer builder.deinit();
+
+    var refs: [40]Ref = undefined;
+    var expected: [40][32]u8 = undefined;
+    var expected_lens: [40]usize = undefined;
+    for (&refs, &expected, &expected_lens, 0..) |*ref, *text, *len, i| {
+        len.* = (try std.fmt.bufPrint(text, "line number {} of many", .{i})).len;
+        ref.* = try builder.add(text[0..len.*]);
+    }
+    const empty = try builder.add("");
+
+    var arena = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena.deinit();
+    const store = try builder.finish(arena.allocator());
+    try t.expect(store.blocks.len > 2);
+
+    var cache = try Cache.init(t.allocator, 2);
+    defer cache.deinit(t.allocator);
+
+    // forwards, backwards and forwards again, so blocks are evicted and decompressed again
+    for (0..3) |pass| for (0..refs.len) |j| {
+        const i = if (pass == 1) refs.len - 1 - j else j;
+        try t.expectEqualStrings(expected[i][0..expected_lens[i]], try cache.get(t.allocator, &store, refs[i]));
+    };
+    try t.expectEqualStrings("", try cache.get(t.allocator, &store, empty));
+    try t.expect(Ref.none.isNone());
+
+    // the most recently used block stays cached
+    _ = try cache.get(t.allocator, &store, refs[0]);
+    _ = try cache.get(t.allocator, &store, refs[refs.len - 1]);
+    _ = try cache.get(t.allocator, &store, refs[0]);
+    _ = try cache.get(t.allocator, &store, refs[refs.len / 2]);
+    try t.expect(cache.slots[0].block == refs[0].block or cache.slots[1].block == refs[0].block);
+}
@@ -0,0 +1,274 @@
+//! Variables shared by many contexts, e.g. world flags like "met the king" which every
+//! NPC's dialogue should see as soon as the game sets them once.
+//! Contexts stepping on any thread read without locking:
+//! - booleans are an atomic bitset
+//! - strings are versioned, a write publishes a new immutable version and retires the old one,
+//!   which is only freed once every reader that could have loaded it ended its read section,
+//!   like epoch based RCU: each reader publishes the epoch its read section began in, and a
+//!   version retired in an older epoch than every active reader's can't be in use anymore
+//! String writes are serialized with a mutex, boolean writes are lock free.
+//! The set of variables is fixed when the world state is created.
+
+const std = @import("std");
+const usz = @import("./config.zig").usz;
+
+const Word = usize;
+const word_bits = @bitSizeOf(Word);
+
+const StringVersion = struct {
+    version: u64,
+    value: []const u8,
+};
+
+const RetiredVersion = struct {
+    version: *const StringVersion,
+    /// the epoch it was replaced in
+    epoch: u64,
+};
+
+/// a thread's (or a context's) registration as a reader of strings, @see registerReader
+pub const Reader = struct {
+    /// the epoch the current read section began in, 0 outside of one
+    epoch: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    /// nesting of read sections, only touched by the reader
+    depth: u32 = 0,
+};
+
+alloc: std.mem.Allocator,
+
+/// name -> index, never mutated after init so lookups are thread safe
+boolean_ids: std.StringArrayHashMapUnmanaged(void) = .{},
+booleans: []std.atomic.Value(Word),
+
+string_ids: std.StringArrayHashMapUnmanaged(void) = .{},
+/// null if the string was never set
+strings: []std.atomic.Value(?*const StringVersion),
+
+/// advanced on every string write, starts at 1 so that 0 means not reading
+epoch: std.atomic.Value(u64) = std.atomic.Value(u64).init(1),
+/// guards writes, the readers list and the retired list
+write_mutex: std.Thread.Mutex = .{},
+readers: std.ArrayListUnmanaged(*Reader) = .{},
+/// replaced string versions which a reader may still be using
+retired: std.ArrayListUnmanaged(RetiredVersion) = .{},
+
+const Self = @This();
+
+/// the names are copied
+pub fn init(alloc: std.mem.Allocator, boolean_names: []const []const u8, string_names: []const []const u8) !Self {
+    var self = Self{
+        .alloc = alloc,
+        .booleans = try alloc.alloc(std.atomic.Value(Word), std.math.divCeil(usize, boolean_names.len, word_bits) catch unreachable),
+        .strings = &.{},
+    };
+    errdefer self.deinit();
+
+    for (self.booleans) |*word| word.* = std.atomic.Value(Word).init(0);
+
+    self.strings = try alloc.alloc(std.atomic.Value(?*const StringVersion), string_names.len);
+    for (self.strings) |*slot| slot.* = std.atomic.Value(?*const StringVersion).init(null);
+
+    try self.boolean_ids.ensureTotalCapacity(alloc, boolean_names.len);
+    for (boolean_names) |name| self.boolean_ids.putAssumeCapacity(try alloc.dupe(u8, name), {});
+
+    try self.string_ids.ensureTotalCapacity(alloc, string_names.len);
+    for (string_names) |name| self.string_ids.putAssumeCapacity(try alloc.dupe(u8, name), {});
+
+    return self;
+}
+
+/// no context may be using the world state anymore
+pub fn deinit(self: *Self) void {
+    for (self.boolean_ids.keys()) |name| self.alloc.free(name);
+    self.boolean_ids.deinit(self.alloc);
+    for (self.string_ids.keys()) |name| self.alloc.free(name);
+    self.string_ids.deinit(self.alloc);
+
+    self.alloc.free(self.booleans);
+    for (self.strings) |*slot| if (slot.raw) |version| self.freeVersion(version);
+    self.alloc.free(self.strings);
+    for (self.retired.items) |retired| self.freeVersion(retired.version);
+    self.retired.deinit(self.alloc);
+    for (self.readers.items) |reader| self.alloc.destroy(reader);
+    self.readers.deinit(self.alloc);
+}
+
+pub fn getBooleanIndex(self: *const Self, name: []const u8) ?usz {
+    return if (self.boolean_ids.getIndex(name)) |index| @intCast(index) else null;
+}
+
+pub fn getStringIndex(self: *const Self, name: []const u8) ?usz {
+    return if (self.string_ids.getIndex(name)) |index| @intCast(index) else null;
+}
+
+pub fn getBoolean(self: *const Self, index: usz) bool {
+    const word = self.booleans[index / word_bits].load(.acquire);
+    return word & (@as(Word, 1) << @intCast(index % word_bits)) != 0;
+}
+
+pub fn setBoolean(self: *Self, index: usz, value: bool) void {
+    const mask = @as(Word, 1) << @intCast(index % word_bits);
+    const word = &self.booleans[index / word_bits];
+    if (value) {
+        _ = word.fetchOr(mask, .release);
+    } else {
+        _ = word.fetchAnd(~mask, .release);
+    }
+}
+
+/// each thread or context reading strings needs its own reader, used by one thread at a time.
+/// Readers are freed by unregisterReader or deinit
+pub fn registerReader(self: *Self) !*Reader {
+    self.write_mutex.lock();
+    defer self.write_mutex.unlock();
+
+    try self.readers.ensureUnusedCapacity(self.alloc, 1);
+    const reader = try self.alloc.create(Reader);
+    reader.* = .{};
+    self.readers.appendAssumeCapacity(reader);
+    return reader;
+}
+
+/// the reader must not be in a read section
+pub fn unregisterReader(self: *Self, reader: *Reader) void {
+    std.debug.assert(reader.depth == 0);
+    self.write_mutex.lock();
+    defer self.write_mutex.unlock();
+
+    const index = std.mem.indexOfScalar(*Reader, self.readers.items, reader).?;
+    _ = self.readers.swapRemove(index);
+    self.alloc.destroy(reader);
+}
+
+/// strings may only be read between beginRead and endRead, after which they may be freed.
+/// Read sections may nest and are cheap. A section only keeps the versions replaced while it is
+/// active from being freed, so one which never ends makes those accumulate
+pub fn beginRead(self: *Self, reader: *Reader) void {
+    if (reader.depth == 0) reader.epoch.store(self.epoch.load(.seq_cst), .seq_cst);
+    reader.depth += 1;
+}
+
+pub fn endRead(self: *Self, reader: *Reader) void {
+    _ = self;
+    reader.depth -= 1;
+    if (reader.depth == 0) reader.epoch.store(0, .seq_cst);
+}
+
+/// must be called within a read section of `reader`, null if the string was never set
+pub fn readString(self: *const Self, reader: *const Reader, index: usz) ?[]const u8 {
+    std.debug.assert(reader.depth > 0);
+    const version = self.strings[index].load(.seq_cst) orelse return null;
+    return version.value;
+}
+
+/// the value is copied
+pub fn setString(self: *Self, index: usz, value: []const u8) !void {
+    self.write_mutex.lock();
+    defer self.write_mutex.unlock();
+
+    try self.retired.ensureUnusedCapacity(self.alloc, 1);
+
+    const version = try self.alloc.create(StringVersion);
+    errdefer self.alloc.destroy(version);
+    version.* = .{
+        .version = if (self.strings[index].load(.monotonic)) |prev| prev.version + 1 else 0,
+        .value = try self.alloc.dupe(u8, value),
+    };
+
+    if (self.strings[index].swap(version, .seq_cst)) |prev|
+        self.retired.appendAssumeCapacity(.{ .version = prev, .epoch = self.epoch.fetchAdd(1, .seq_cst) });
+
+    self.collectLocked();
+}
+
+/// free replaced strings if no reader can still be using them.
+/// called on every string write, but may be called by the host when convenient too
+pub fn collectGarbage(self: *Self) void {
+    self.write_mutex.lock();
+    defer self.write_mutex.unlock();
+    self.collectLocked();
+}
+
+fn collectLocked(self: *Self) void {
+    // a reader which loaded a retired version published its epoch before doing so, and one whose
+    // epoch is newer than the version's loaded the epoch after the version was replaced
+    var oldest_reading: u64 = std.math.maxInt(u64);
+    for (self.readers.items) |reader| {
+        const epoch = reader.epoch.load(.seq_cst);
+        if (epoch != 0) oldest_reading = @min(oldest_reading, epoch);
+    }
+
+    var kept: usize = 0;
+    for (self.retired.items) |retired| {
+        if (retired.epoch < oldest_reading) {
+            self.freeVersion(retired.version);
+        } else {
+            self.retired.items[kept] = retired;
+            kept += 1;
+        }
+    }
+    self.retired.shrinkRetainingCapacity(kept);
+}
+
+fn freeVersion(self: *Self, version: *const StringVersion) void {
+    self.alloc.free(version.value);
+    self.alloc.destroy(version);
+}
+
+const t = std.testing;
+
+test "world state" {
+    var world = try Self.init(t.allocator, &.{ "met the king", "quest complete" }, &.{"king name"});
+    defer world.deinit();
+
+    const quest_complete = world.getBooleanIndex("quest complete").?;
+    try t.expect(!world.getBoolean(quest_complete));
+    world.setBoolean(quest_complete, true);
+    try t.expect(world.getBoolean(quest_complete));
+    try t.expect(!world.getBoolean(world.getBooleanIndex("met the king").?));
+
+    const king_name = world.getStringIndex("king name").?;
+    const reader = try world.registerReader();
+    world.beginRead(reader);
+    try t.expectEqual(@as(?[]const u8, null), world.readString(reader, king_name));
+    try world.setString(king_name, "Arthur");
+    const read_arthur = world.readString(reader, king_name).?;
+    try world.setString(king_name, "Bert");
+    // still valid while reading
+    try t.expectEqualStrings("Arthur", read_arthur);
+    try t.expectEqualStrings("Bert", world.readString(reader, king_name).?);
+    world.endRead(reader);
+
+    world.collectGarbage();
+    try t.expectEqual(@as(usize, 0), world.retired.items.len);
+    world.unregisterReader(reader);
+}
+
+test "overlapping readers don't keep every old string" {
+    var world = try Self.init(t.allocator, &.{}, &.{"king name"});
+    defer world.deinit();
+    const king_name = world.getStringIndex("king name").?;
+
+    const a = try world.registerReader();
+    const b = try world.registerReader();
+    try world.setString(king_name, "0");
+
+    // the readers take turns so that one is always reading, which a single count of active
+    // readers could never tell apart from a reader holding the oldest version
+    world.beginRead(a);
+    var buf: [8]u8 = undefined;
+    for (1..100) |i| {
+        const reader = if (i % 2 == 0) a else b;
+        const other = if (i % 2 == 0) b else a;
+        world.beginRead(reader);
+        try t.expect(world.readString(reader, king_name) != null);
+        world.endRead(other);
+        try world.setString(king_name, try std.fmt.bufPrint(&buf, "{}", .{i}));
+        // only the versions replaced since the oldest active section began are kept
+        try t.expect(world.retired.items.len <= 2);
+    }
+    // the last one began on an odd turn
+    world.endRead(b);
+    world.collectGarbage();
+    try t.expectEqual(@as(usize, 0), world.retired.items.len);
+}
@@ -14,6 +14,9 @@ const OptSlice = @import("./slice.zig").OptSlice;
 const FileBuffer = @import("./FileBuffer.zig");
 
 const ConfigurableSimpleAlloc = @import("./simple_alloc.zig").ConfigurableSimpleAlloc;
+const AllocatorCallbacks = @import("./simple_alloc.zig").AllocatorCallbacks;
+const CallbacksAlloc = @import("./simple_alloc.zig").CallbacksAlloc;
+const PoolAlloc = @import("./PoolAlloc.zig");
 var configured_raw_alloc: ?ConfigurableSimpleAlloc = null;
 
 const is_wasm = builtin.os.tag == .freestanding and builtin.target.cpu.arch == .wasm32;
@@ -81,6 +84,9 @@ pub const DiagnosticErrors = enum(c_int) {
     // CApiUniqueErrors
     AlternisAllocatorUnset,
 
+    // added after the C API errors to keep existing codes stable
+    AlternisBadCondition,
+
     pub fn fromZig(err: CApiDiagnosticErrors) @This() {
         return switch (err) {
             inline else => |e| @field(DiagnosticErrors, @errorName(e)),
@@ -93,6 +99,8 @@ pub const Diagnostic = extern struct {
     _needs_free: bool = false,
     error_code: DiagnosticErrors = .NoError,
     error_message: Slice(u8) = undefined,
+    /// the allocator callbacks of the failed context, if it had any, which own the message
+    _allocator: ?*const AllocatorCallbacks = null,
 
     pub export fn ade_diagnostic_destroy(maybe_self: ?*@This()) void {
         if (maybe_self) |self| {
@@ -100,7 +108,12 @@ pub const Diagnostic = extern struct {
                 .error_message = self.error_message,
                 ._needs_free = self._needs_free,
             };
-            zig_diagnostic.free(alloc);
+            if (self._allocator) |callbacks| {
+                var callbacks_alloc = CallbacksAlloc.init(callbacks.*);
+                zig_diagnostic.free(callbacks_alloc.allocator());
+            } else {
+                zig_diagnostic.free(alloc);
+            }
         }
     }
 
@@ -116,57 +129,320 @@ pub const Diagnostic = extern struct {
     }
 };
 
-/// when returning null, the diagnostic will be set with an error code
-/// See DialogueContext.initFromJson for more documentation
-pub export fn ade_dialogue_ctx_create_json(
-    json_ptr: [*]const u8,
-    json_len: usize,
-    random_seed: u64,
-    no_interpolate: bool,
+/// options for creating a DialogueContext, see DialogueContext.InitOpts for documentation
+pub const CreateOpts = extern struct {
+    random_seed: u64 = 0,
+    no_interpolate: bool = false,
+    output_encoding: Api.TextEncoding = .utf8,
+    /// serve the context's small allocations from size class pools, @see PoolAlloc
+    use_pool_allocator: bool = false,
+    /// if set, all of the context's memory comes from these callbacks instead of the allocator
+    /// from ade_set_alloc. Must outlive the context (and any diagnostic from creating it)
+    allocator: ?*const AllocatorCallbacks = null,
+    /// variables shared with other contexts, @see ade_world_state_create
+    world_state: ?*Api.WorldState = null,
+    /// if set, a binary trace of the context is written to this sink, @see trace.zig
+    trace_sink: ?*const Api.trace.Sink = null,
+    /// the size of the trace buffer, which is handed to the sink whenever it fills. 0 for a default
+    trace_buffer_len: usize = 0,
+    /// threads to compile the dialogues on, 0 for one per core when there are many dialogues
+    compile_thread_count: u32 = 0,
+    /// if not 0, stepping pushes events into a ring of this many events (rounded up to a power
+    /// of two) instead of calling callbacks, @see ade_dialogue_ctx_drain_events
+    event_ring_len: usize = 0,
+    /// the amount of latest variable changes kept for ade_dialogue_ctx_changes_since, 0 for a default
+    change_log_capacity: usize = 0,
+    compress_text: bool = false,
+    /// the amount of decompressed text blocks kept with compress_text, 0 for a default
+    text_cache_blocks: usize = 0,
+};
+
+/// The C API's storage for a context, which owns the allocator it was created with
+const CContext = struct {
+    ctx: Api.DialogueContext,
+    backing: union(enum) {
+        /// the allocator from ade_set_alloc
+        global,
+        callbacks: CallbacksAlloc,
+    },
+    pool: ?PoolAlloc = null,
+    trace: ?Api.trace.Recorder = null,
+    events: ?Api.EventRing = null,
+
+    const default_trace_buffer_len = 4096;
+
+    fn fromCtx(ctx: *Api.DialogueContext) *@This() {
+        return @fieldParentPtr("ctx", ctx);
+    }
+
+    fn backingAllocator(self: *@This()) std.mem.Allocator {
+        return switch (self.backing) {
+            .global => alloc,
+            .callbacks => |*callbacks_alloc| callbacks_alloc.allocator(),
+        };
+    }
+
+    fn allocator(self: *@This()) std.mem.Allocator {
+        return if (self.pool) |*pool| pool.allocator() else self.backingAllocator();
+    }
+
+    /// the context must already be deinitialized
+    fn destroy(self: *@This()) void {
+        if (self.trace) |*recorder| {
+            recorder.flush();
+            self.backingAllocator().free(recorder.buffer);
+        }
+        if (self.events) |*events| self.backingAllocator().free(events.buffer);
+        if (self.pool) |*pool| pool.deinit();
+        // copied since it is freed by itself
+        var backing = self.backing;
+        const backing_alloc = switch (backing) {
+            .global => alloc,
+            .callbacks => |*callbacks_alloc| callbacks_alloc.allocator(),
+        };
+        backing_alloc.destroy(self);
+    }
+};
+
+/// create a context from json, or shared from a source context if it is set
+fn createCContext(
+    json: []const u8,
+    source: ?*const Api.DialogueContext,
+    opts: *const CreateOpts,
     c_diagnostic: *Diagnostic,
 ) ?*Api.DialogueContext {
     c_diagnostic.error_code = .NoError;
+    c_diagnostic._allocator = null;
     var zig_diagnostic = Api.DialogueContext.Diagnostic{};
 
-    if (!is_allocator_set) {
+    if (opts.allocator == null and !is_allocator_set) {
         c_diagnostic.*.error_message = Slice(u8).fromZig("allocator was unset, call ade_set_alloc first");
         c_diagnostic.*.error_code = DiagnosticErrors.fromZig(error.AlternisAllocatorUnset);
         c_diagnostic.*._needs_free = false;
         return null;
     }
 
-    const ctx_result = Api.DialogueContext.initFromJson(
-        json_ptr[0..json_len],
-        alloc,
-        .{ .random_seed = random_seed, .no_interpolate = no_interpolate },
-        &zig_diagnostic,
-    ) catch |e| return {
-        c_diagnostic.* = Diagnostic.fromZigErr(e, zig_diagnostic);
-        return null;
-    };
+    var creating_callbacks_alloc = if (opts.allocator) |callbacks| CallbacksAlloc.init(callbacks.*) else null;
+    const creating_alloc = if (creating_callbacks_alloc) |*callbacks_alloc| callbacks_alloc.allocator() else alloc;
 
-    errdefer ctx_result.deinit(alloc);
-
-    const ctx_slot = alloc.create(Api.DialogueContext) catch |e| {
+    const c_ctx = creating_alloc.create(CContext) catch |e| {
         c_diagnostic.*.error_message = Slice(u8).fromZig("failed to allocate, see error code");
         c_diagnostic.*.error_code = DiagnosticErrors.fromZig(e);
         c_diagnostic.*._needs_free = false;
         return null;
     };
-    ctx_slot.* = ctx_result;
 
-    return ctx_slot;
+    c_ctx.* = .{
+        .ctx = undefined,
+        .backing = if (opts.allocator) |callbacks| .{ .callbacks = CallbacksAlloc.init(callbacks.*) } else .global,
+    };
+
+    if (opts.use_pool_allocator)
+        c_ctx.pool = PoolAlloc.init(c_ctx.backingAllocator());
+
+    if (opts.trace_sink) |sink| {
+        const buffer_len = if (opts.trace_buffer_len != 0) opts.trace_buffer_len else CContext.default_trace_buffer_len;
+        const buffer = c_ctx.backingAllocator().alloc(u8, buffer_len) catch |e| {
+            c_diagnostic.*.error_message = Slice(u8).fromZig("failed to allocate, see error code");
+            c_diagnostic.*.error_code = DiagnosticErrors.fromZig(e);
+            c_diagnostic.*._needs_free = false;
+            c_ctx.destroy();
+            return null;
+        };
+        c_ctx.trace = Api.trace.Recorder.init(buffer, sink.*);
+    }
+
+    if (opts.event_ring_len != 0) {
+        // a length too large to round up fails to allocate anyway
+        const ring_len = std.math.ceilPowerOfTwo(usize, opts.event_ring_len) catch @as(usize, 1) << (@bitSizeOf(usize) - 1);
+        const buffer = c_ctx.backingAllocator().alloc(Api.EventRing.Event, ring_len) catch |e| {
+            c_diagnostic.*.error_message = Slice(u8).fromZig("failed to allocate, see error code");
+            c_diagnostic.*.error_code = DiagnosticErrors.fromZig(e);
+            c_diagnostic.*._needs_free = false;
+            c_ctx.destroy();
+            return null;
+        };
+        c_ctx.events = Api.EventRing.init(buffer);
+    }
+
+    const init_opts = Api.DialogueContext.InitOpts{
+        .random_seed = opts.random_seed,
+        .no_interpolate = opts.no_interpolate,
+        .output_encoding = opts.output_encoding,
+        // the pool is destroyed on failure, so the message must outlive it
+        .diagnostic_alloc = c_ctx.backingAllocator(),
+        .world_state = opts.world_state,
+        .trace = if (c_ctx.trace) |*recorder| recorder else null,
+        .events = if (c_ctx.events) |*events| events else null,
+        .change_log_capacity = if (opts.change_log_capacity != 0) opts.change_log_capacity else (Api.DialogueContext.InitOpts{}).change_log_capacity,
+        .compile_thread_count = if (opts.compile_thread_count != 0) opts.compile_thread_count else null,
+        .compress_text = opts.compress_text,
+        .text_cache_blocks = if (opts.text_cache_blocks != 0) opts.text_cache_blocks else (Api.DialogueContext.InitOpts{}).text_cache_blocks,
+    };
+
+    c_ctx.ctx = (if (source) |source_ctx|
+        Api.DialogueContext.initShared(source_ctx, c_ctx.allocator(), init_opts, &zig_diagnostic)
+    else
+        Api.DialogueContext.initFromJson(json, c_ctx.allocator(), init_opts, &zig_diagnostic)) catch |e| {
+        c_diagnostic.* = Diagnostic.fromZigErr(e, zig_diagnostic);
+        c_diagnostic._allocator = opts.allocator;
+        c_ctx.destroy();
+        return null;
+    };
+
+    return &c_ctx.ctx;
+}
+
+/// when returning null, the diagnostic will be set with an error code
+/// See DialogueContext.initFromJson for more documentation
+pub export fn ade_dialogue_ctx_create_json(
+    json_ptr: [*]const u8,
+    json_len: usize,
+    random_seed: u64,
+    no_interpolate: bool,
+    c_diagnostic: *Diagnostic,
+) ?*Api.DialogueContext {
+    return ade_dialogue_ctx_create_json_opts(
+        json_ptr,
+        json_len,
+        &.{ .random_seed = random_seed, .no_interpolate = no_interpolate },
+        c_diagnostic,
+    );
+}
+
+/// when returning null, the diagnostic will be set with an error code
+/// See DialogueContext.initFromJson for more documentation
+pub export fn ade_dialogue_ctx_create_json_opts(
+    json_ptr: [*]const u8,
+    json_len: usize,
+    opts: *const CreateOpts,
+    c_diagnostic: *Diagnostic,
+) ?*Api.DialogueContext {
+    return createCContext(json_ptr[0..json_len], null, opts, c_diagnostic);
+}
+
+/// create a context which shares the compiled dialogues of an existing one, @see DialogueContext.initShared
+/// the source context must not be destroyed before the returned context.
+/// when returning null, the diagnostic will be set with an error code
+pub export fn ade_dialogue_ctx_create_shared(
+    source: *const Api.DialogueContext,
+    opts: *const CreateOpts,
+    c_diagnostic: *Diagnostic,
+) ?*Api.DialogueContext {
+    return createCContext(&.{}, source, opts, c_diagnostic);
 }
 
 export fn ade_dialogue_ctx_destroy(in_dialogue_ctx: ?*Api.DialogueContext) void {
     const ctx = in_dialogue_ctx orelse return;
-    ctx.deinit(alloc);
-    alloc.destroy(ctx);
+    const c_ctx = CContext.fromCtx(ctx);
+    ctx.deinit(c_ctx.allocator());
+    c_ctx.destroy();
+}
+
+fn worldStateNames(names_ptr: ?[*]const Slice(u8), names_len: usize) ![]const []const u8 {
+    const names = try alloc.alloc([]const u8, names_len);
+    if (names_len > 0) for (names, names_ptr.?[0..names_len]) |*name, c_name| {
+        name.* = c_name.toZig();
+    };
+    return names;
+}
+
+/// create a store of variables which may be shared by many contexts, see WorldState.
+/// The names are copied. Uses the allocator from ade_set_alloc, returns null if allocation failed
+export fn ade_world_state_create(
+    boolean_names_ptr: ?[*]const Slice(u8),
+    boolean_names_len: usize,
+    string_names_ptr: ?[*]const Slice(u8),
+    string_names_len: usize,
+) ?*Api.WorldState {
+    if (!is_allocator_set) return null;
+
+    const boolean_names = worldStateNames(boolean_names_ptr, boolean_names_len) catch return null;
+    defer alloc.free(boolean_names);
+    const string_names = worldStateNames(string_names_ptr, string_names_len) catch return null;
+    defer alloc.free(string_names);
+
+    const world = alloc.create(Api.WorldState) catch return null;
+    world.* = Api.WorldState.init(alloc, boolean_names, string_names) catch {
+        alloc.destroy(world);
+        return null;
+    };
+    return world;
+}
+
+/// every context using the world state must be destroyed first
+export fn ade_world_state_destroy(in_world: ?*Api.WorldState) void {
+    const world = in_world orelse return;
+    world.deinit();
+    alloc.destroy(world);
+}
+
+/// may be called from any thread, returns false if there is no such variable
+export fn ade_world_state_set_boolean(world: *Api.WorldState, name_ptr: [*]const u8, name_len: usize, value: bool) bool {
+    const index = world.getBooleanIndex(name_ptr[0..name_len]) orelse return false;
+    world.setBoolean(index, value);
+    return true;
+}
+
+export fn ade_world_state_get_boolean(world: *Api.WorldState, name_ptr: [*]const u8, name_len: usize) bool {
+    const index = world.getBooleanIndex(name_ptr[0..name_len]) orelse return false;
+    return world.getBoolean(index);
+}
+
+/// the value is copied, may be called from any thread.
+/// returns false if there is no such variable or allocation failed
+export fn ade_world_state_set_string(
+    world: *Api.WorldState,
+    name_ptr: [*]const u8,
+    name_len: usize,
+    value_ptr: [*]const u8,
+    value_len: usize,
+) bool {
+    const index = world.getStringIndex(name_ptr[0..name_len]) orelse return false;
+    world.setString(index, value_ptr[0..value_len]) catch return false;
+    return true;
+}
+
+/// hand any buffered trace bytes to the trace sink, they are also flushed when the context is destroyed
+export fn ade_dialogue_ctx_flush_trace(in_dialogue_ctx: ?*Api.DialogueContext) void {
+    const ctx = in_dialogue_ctx orelse return;
+    if (ctx.trace) |recorder| recorder.flush();
+}
+
+/// move up to events_len of the oldest events from the context's event ring into events, returning
+/// how many. May be called on another thread than the one stepping the context, but only one at a time
+export fn ade_dialogue_ctx_drain_events(in_dialogue_ctx: ?*Api.DialogueContext, events_ptr: [*]Api.EventRing.Event, events_len: usize) usize {
+    const ctx = in_dialogue_ctx orelse return 0;
+    const events = ctx.events orelse return 0;
+    return events.drain(events_ptr[0..events_len]);
+}
+
+/// the amount of events dropped so far because the context's event ring was full
+export fn ade_dialogue_ctx_dropped_events(in_dialogue_ctx: ?*const Api.DialogueContext) usize {
+    const ctx = in_dialogue_ctx orelse return 0;
+    const events = ctx.events orelse return 0;
+    return events.droppedCount();
+}
+
+export fn ade_dialogue_ctx_memory_report(in_dialogue_ctx: ?*const Api.DialogueContext, report_loc: ?*Api.DialogueContext.MemoryReport) void {
+    const ctx = in_dialogue_ctx orelse return;
+    (report_loc orelse return).* = ctx.memoryReport();
 }
 
 export fn ade_dialogue_ctx_reset(in_dialogue_ctx: ?*Api.DialogueContext, dialogue_id: usz, node_index: usz) void {
     const ctx = in_dialogue_ctx orelse return;
-    ctx.reset(node_index, dialogue_id);
+    ctx.reset(dialogue_id, node_index);
+}
+
+/// the amount of random draws a dialogue made, @see DialogueContext.randomDraws
+export fn ade_dialogue_ctx_get_random_draws(in_dialogue_ctx: ?*const Api.DialogueContext, dialogue_id: usz) u64 {
+    const ctx = in_dialogue_ctx orelse return 0;
+    return ctx.randomDraws(dialogue_id);
+}
+
+export fn ade_dialogue_ctx_set_random_draws(in_dialogue_ctx: ?*Api.DialogueContext, dialogue_id: usz, draws: u64) void {
+    const ctx = in_dialogue_ctx orelse return;
+    ctx.setRandomDraws(dialogue_id, draws);
 }
 
 export fn ade_dialogue_ctx_reply(in_dialogue_ctx: ?*Api.DialogueContext, dialogue_id: usz, reply_id: usize) void {
@@ -202,6 +478,71 @@ export fn ade_dialogue_ctx_set_variable_string(
     ctx.setVariableString(name[0..len], value_ptr[0..value_len]);
 }
 
+export fn ade_dialogue_ctx_get_variable_boolean(
+    in_dialogue_ctx: ?*Api.DialogueContext,
+    name: [*]const u8,
+    len: usize,
+) bool {
+    const ctx = in_dialogue_ctx orelse return false;
+    return ctx.getVariableBoolean(name[0..len]);
+}
+
+/// the value is only valid until the variable is next set, or for a variable bound to a world
+/// state until the next get of a string variable, @see DialogueContext.getVariableString
+export fn ade_dialogue_ctx_get_variable_string(
+    in_dialogue_ctx: ?*Api.DialogueContext,
+    name: [*]const u8,
+    len: usize,
+    value_loc: ?*Slice(u8),
+) void {
+    const ctx = in_dialogue_ctx orelse return;
+    (value_loc orelse return).* = Slice(u8).fromZig(ctx.getVariableString(name[0..len]) orelse "");
+}
+
+/// the sequence number of the context's latest variable change, 0 before any change
+export fn ade_dialogue_ctx_latest_change_seq(in_dialogue_ctx: ?*const Api.DialogueContext) u64 {
+    const ctx = in_dialogue_ctx orelse return 0;
+    return ctx.latestChangeSeq();
+}
+
+/// write the variable changes after the sequence number seq into changes, oldest first, @see ChangeLog.changesSince
+export fn ade_dialogue_ctx_changes_since(
+    in_dialogue_ctx: ?*const Api.DialogueContext,
+    seq: u64,
+    changes_ptr: [*]Api.ChangeLog.Change,
+    changes_len: usize,
+    result_loc: ?*Api.ChangeLog.ChangesSince,
+) void {
+    const ctx = in_dialogue_ctx orelse return;
+    const result = ctx.changesSince(seq, changes_ptr[0..changes_len]);
+    if (result_loc) |loc| loc.* = result;
+}
+
+/// write the indices of the variables of a type which changed since last taken, returning how many
+export fn ade_dialogue_ctx_take_dirty_variables(
+    in_dialogue_ctx: ?*Api.DialogueContext,
+    var_type: Api.ChangeLog.VariableType,
+    indices_ptr: [*]usz,
+    indices_len: usize,
+) usize {
+    const ctx = in_dialogue_ctx orelse return 0;
+    return ctx.takeDirtyVariables(var_type, indices_ptr[0..indices_len]);
+}
+
+/// get the name of a variable by its index among the variables of its type,
+/// returning false if there is no such variable
+export fn ade_dialogue_ctx_get_variable_name(
+    in_dialogue_ctx: ?*const Api.DialogueContext,
+    var_type: Api.ChangeLog.VariableType,
+    index: usz,
+    name_loc: ?*Slice(u8),
+) bool {
+    const ctx = in_dialogue_ctx orelse return false;
+    const name = ctx.variableName(var_type, index) orelse return false;
+    if (name_loc) |loc| loc.* = Slice(u8).fromZig(name);
+    return true;
+}
+
 /// the passed in pointers must exist as long as this is set
 export fn ade_dialogue_ctx_set_callback(
     in_dialogue_ctx: ?*Api.DialogueContext,
@@ -244,6 +585,20 @@ export fn ade_dialogue_ctx_step(dialogue_ctx: *Api.DialogueContext, dialogue_id:
     (result_loc orelse return).* = dialogue_ctx.step(dialogue_id);
 }
 
+export fn ade_dialogue_ctx_advance(
+    dialogue_ctx: *Api.DialogueContext,
+    dialogue_id: usz,
+    lines_ptr: [*]Api.Line,
+    lines_len: usize,
+    result_loc: ?*Api.DialogueContext.AdvanceResult,
+) void {
+    (result_loc orelse return).* = dialogue_ctx.advance(dialogue_id, lines_ptr[0..lines_len]);
+}
+
+export fn ade_dialogue_ctx_peek(dialogue_ctx: *Api.DialogueContext, dialogue_id: usz, lines_ptr: [*]Api.Line, lines_len: usize) usize {
+    return dialogue_ctx.peek(dialogue_id, lines_ptr[0..lines_len]);
+}
+
 // export fn ade_diagnostic_destroy(in_diagnostic: ?*Api.DialogueContext.Diagnostic) void {
 // (in_diagnostic orelse return).free(alloc);
 // }
@@ -288,3 +643,49 @@ test "run small dialogue under c api" {
     try t.expect(step_result.tag == .done);
     try t.expectEqual(@as(?usz, null), ctx.?.getCurrentNodeIndex(0));
 }
+
+test "per context allocator with pool" {
+    const CountingAlloc = struct {
+        live_allocations: usize = 0,
+
+        fn malloc(len: usize, user: ?*anyopaque) callconv(.C) ?*anyopaque {
+            const self: *@This() = @alignCast(@ptrCast(user.?));
+            self.live_allocations += 1;
+            return std.c.malloc(len);
+        }
+
+        fn free(ptr: ?*anyopaque, user: ?*anyopaque) callconv(.C) void {
+            const self: *@This() = @alignCast(@ptrCast(user.?));
+            self.live_allocations -= 1;
+            std.c.free(ptr);
+        }
+    };
+
+    var counting_alloc = CountingAlloc{};
+    const callbacks = AllocatorCallbacks{
+        .malloc = CountingAlloc.malloc,
+        .free = CountingAlloc.free,
+        .user = &counting_alloc,
+    };
+
+    const src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/sample1.alternis.json");
+    defer src.free(t.allocator);
+
+    var diagnostic = Diagnostic{};
+    const ctx = ade_dialogue_ctx_create_json_opts(src.buffer.ptr, src.buffer.len, &.{
+        .random_seed = 0,
+        .use_pool_allocator = true,
+        .allocator = &callbacks,
+    }, &diagnostic);
+    try t.expectEqual(diagnostic.error_code, .NoError);
+    try t.expect(ctx != null);
+    try t.expect(counting_alloc.live_allocations > 0);
+
+    var step_result: Api.DialogueContext.StepResult = undefined;
+    ade_dialogue_ctx_step(ctx.?, 0, &step_result);
+    try t.expect(step_result.tag == .line);
+    try t.expectEqualStrings("Hey", step_result.data.line.text.toZig());
+
+    ade_dialogue_ctx_destroy(ctx);
+    try t.expectEqual(@as(usize, 0), counting_alloc.live_allocations);
+}
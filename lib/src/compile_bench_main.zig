@@ -0,0 +1,117 @@
+//! alternis-compile-bench: time loading a generated file of many dialogues on one thread and
+//! in parallel, to check that compiling in parallel scales instead of contending on allocation.
+
+const std = @import("std");
+const DialogueContext = @import("./main.zig").DialogueContext;
+
+const usage =
+    \\usage: alternis-compile-bench [--dialogues N] [--threads N] [--runs N]
+    \\
+    \\Generates a file of many dialogues and reports the fastest load of each mode.
+    \\  --dialogues N  the amount of dialogues to generate, defaults to 4000
+    \\  --threads N    the amount of threads to compile with, defaults to the amount of cores
+    \\  --runs N       the amount of loads per mode, defaults to 5
+    \\
+;
+
+fn generate(alloc: std.mem.Allocator, dialogue_count: usize) ![]u8 {
+    var src = std.ArrayList(u8).init(alloc);
+    errdefer src.deinit();
+    const writer = src.writer();
+
+    try writer.writeAll("{\"version\": 1, \"dialogues\": {");
+    for (0..dialogue_count) |i| {
+        if (i != 0) try writer.writeByte(',');
+        try writer.print("\"d{}\": {{\"nodes\": [", .{i});
+        // a few lines and a reply with conditions, about the shape of a conversation with an NPC
+        for (0..8) |j| try writer.print(
+            \\{{"line": {{"data": {{"speaker": "npc {}", "text": "line {} of dialogue {}, {{name}}"}}, "next": {}}}}},
+        , .{ i % 50, j, i, j + 1 });
+        try writer.writeAll(
+            \\{"reply": {"nexts": [0, 9, null], "texts": [
+            \\  {"speaker": "player", "text": "again"}, {"speaker": "player", "text": "thanks"}, {"speaker": "player", "text": "bye"}
+            \\], "conditions": [
+            \\  {"action": "expr", "expr": {"and": [{"not": {"var": "done"}}, {"neq": [{"var": "name"}, {"str": "x"}]}]}},
+            \\  {"action": "unlocked", "variable": "done"}, {"action": "none"}
+            \\]}},
+            \\{"unlock": {"boolean_var_name": "done", "next": 0}}
+            \\]}
+        );
+    }
+    try writer.writeAll(
+        \\}, "variables": {"boolean": [{"name": "done"}], "string": [{"name": "name"}]}}
+    );
+    return src.toOwnedSlice();
+}
+
+pub fn main() !u8 {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const alloc = gpa.allocator();
+
+    const args = try std.process.argsAlloc(alloc);
+    defer std.process.argsFree(alloc, args);
+
+    const stdout = std.io.getStdOut().writer();
+    const stderr = std.io.getStdErr().writer();
+
+    var dialogue_count: usize = 4000;
+    var thread_count: ?u32 = null;
+    var runs: usize = 5;
+
+    var arg_index: usize = 1;
+    while (arg_index < args.len) : (arg_index += 1) {
+        const arg = args[arg_index];
+        if (std.mem.eql(u8, arg, "--help") or std.mem.eql(u8, arg, "-h")) {
+            try stdout.writeAll(usage);
+            return 0;
+        }
+        const is_count_arg = std.mem.eql(u8, arg, "--dialogues") or std.mem.eql(u8, arg, "--threads") or std.mem.eql(u8, arg, "--runs");
+        if (!is_count_arg or arg_index + 1 >= args.len) {
+            try stderr.writeAll(usage);
+            return 2;
+        }
+        arg_index += 1;
+        const value = std.fmt.parseInt(u32, args[arg_index], 10) catch {
+            try stderr.print("invalid count '{s}' for {s}\n", .{ args[arg_index], arg });
+            return 2;
+        };
+        if (std.mem.eql(u8, arg, "--dialogues")) {
+            dialogue_count = value;
+        } else if (std.mem.eql(u8, arg, "--threads")) {
+            thread_count = value;
+        } else {
+            runs = @max(value, 1);
+        }
+    }
+
+    const src = try generate(alloc, dialogue_count);
+    defer alloc.free(src);
+
+    const Mode = struct { name: []const u8, opts: DialogueContext.InitOpts };
+    const modes = [_]Mode{
+        .{ .name = "one thread", .opts = .{ .random_seed = 0, .compile_thread_count = 1 } },
+        .{ .name = "parallel", .opts = .{ .random_seed = 0, .compile_thread_count = thread_count } },
+        .{ .name = "one thread, compressed", .opts = .{ .random_seed = 0, .compile_thread_count = 1, .compress_text = true } },
+        .{ .name = "parallel, compressed", .opts = .{ .random_seed = 0, .compile_thread_count = thread_count, .compress_text = true } },
+    };
+
+    try stdout.print("{} dialogues, {} bytes\n", .{ dialogue_count, src.len });
+    for (modes) |mode| {
+        var best: u64 = std.math.maxInt(u64);
+        for (0..runs) |_| {
+            var diagnostic = DialogueContext.Diagnostic{};
+            defer diagnostic.free(alloc);
+
+            var timer = try std.time.Timer.start();
+            var ctx = DialogueContext.initFromJson(src, alloc, mode.opts, &diagnostic) catch |e| {
+                try stderr.print("{}: {s}\n", .{ e, diagnostic.error_message.toZig() });
+                return 1;
+            };
+            best = @min(best, timer.read());
+            ctx.deinit(alloc);
+        }
+        try stdout.print("{s}: {d:.3}ms\n", .{ mode.name, @as(f64, @floatFromInt(best)) / std.time.ns_per_ms });
+    }
+    return 0;
+}
@@ -0,0 +1,434 @@
+//! Reply condition expressions, compiled from json when loading into compact bytecode for a
+//! small stack machine, which evaluates them during step without allocating.
+//!
+//! An expression is a json object with one key:
+//! - {"var": "name"}  a boolean or string variable
+//! - {"str": "text"}, {"num": 1.5}  literals
+//! - {"not": expr}, {"and": [expr, ...]}, {"or": [expr, ...]}  on booleans
+//! - {"eq": [a, b]}, {"neq": [a, b]}  on two values of the same type
+//! - {"lt": [a, b]}, {"lte": ...}, {"gt": ...}, {"gte": ...}  on numbers, where string
+//!   variables are parsed as numbers, and the comparison is false if one isn't a number
+
+const std = @import("std");
+const json = std.json;
+const usz = @import("./config.zig").usz;
+const StringVariable = @import("./StringVariable.zig");
+
+pub const Op = enum(u8) {
+    /// followed by a u16 boolean variable index
+    push_bool_var,
+    /// followed by a u16 index into strings of the variable's name
+    push_string_var,
+    /// followed by a u16 index into strings
+    push_string,
+    /// followed by a u16 index into numbers
+    push_number,
+    not,
+    @"and",
+    @"or",
+    eq,
+    neq,
+    lt,
+    lte,
+    gt,
+    gte,
+};
+
+/// expressions needing a deeper stack than this are rejected when compiling
+pub const max_stack = 16;
+
+const Value = union(enum) {
+    boolean: bool,
+    string: []const u8,
+    number: f64,
+
+    fn toNumber(self: @This()) ?f64 {
+        return switch (self) {
+            .number => |v| v,
+            .string => |v| std.fmt.parseFloat(f64, std.mem.trim(u8, v, " ")) catch null,
+            .boolean => unreachable,
+        };
+    }
+
+    fn eql(a: @This(), b: @This()) bool {
+        return switch (a) {
+            .boolean => |v| v == b.boolean,
+            .string => |v| std.mem.eql(u8, v, b.string),
+            .number => |v| v == b.number,
+        };
+    }
+};
+
+pub const Program = struct {
+    code: []const u8,
+    /// string literals and the names of string variables
+    strings: []const []const u8,
+    numbers: []const f64,
+    /// every boolean variable the program reads, for analysis
+    boolean_vars: []const usz,
+    /// whether the result depends on string variables
+    reads_strings: bool,
+
+    /// `vars` must have `getBoolean(index: usz) bool` and `getString(name: []const u8) []const u8`
+    pub fn eval(self: *const @This(), vars: anytype) bool {
+        var stack: [max_stack]Value = undefined;
+        var len: usize = 0;
+        var pc: usize = 0;
+
+        while (pc < self.code.len) {
+            const op: Op = @enumFromInt(self.code[pc]);
+            pc += 1;
+            switch (op) {
+                inline .push_bool_var, .push_string_var, .push_string, .push_number => |push_op| {
+                    const operand = std.mem.readInt(u16, self.code[pc..][0..2], .little);
+                    pc += 2;
+                    stack[len] = switch (push_op) {
+                        .push_bool_var => .{ .boolean = vars.getBoolean(operand) },
+                        .push_string_var => .{ .string = vars.getString(self.strings[operand]) },
+                        .push_string => .{ .string = self.strings[operand] },
+                        .push_number => .{ .number = self.numbers[operand] },
+                        else => unreachable,
+                    };
+                    len += 1;
+                },
+                .not => stack[len - 1] = .{ .boolean = !stack[len - 1].boolean },
+                else => {
+                    const a = stack[len - 2];
+                    const b = stack[len - 1];
+                    len -= 1;
+                    stack[len - 1] = .{ .boolean = switch (op) {
+                        .@"and" => a.boolean and b.boolean,
+                        .@"or" => a.boolean or b.boolean,
+                        else => compare(op, a, b),
+                    } };
+                },
+            }
+        }
+
+        std.debug.assert(len == 1);
+        return stack[0].boolean;
+    }
+
+    /// evaluate three valued with string variables unknown, for analysis. Any comparison reading
+    /// a string variable is unknown, and `not`, `and` and `or` follow Kleene logic, so that e.g.
+    /// `and` with a false operand is still false. Returns null when the result depends on strings.
+    /// `vars` must have `getBoolean(index: usz) bool`
+    pub fn evalBooleans(self: *const @This(), vars: anytype) ?bool {
+        // null for unknown
+        var stack: [max_stack]?Value = undefined;
+        var len: usize = 0;
+        var pc: usize = 0;
+
+        while (pc < self.code.len) {
+            const op: Op = @enumFromInt(self.code[pc]);
+            pc += 1;
+            switch (op) {
+                inline .push_bool_var, .push_string_var, .push_string, .push_number => |push_op| {
+                    const operand = std.mem.readInt(u16, self.code[pc..][0..2], .little);
+                    pc += 2;
+                    stack[len] = switch (push_op) {
+                        .push_bool_var => .{ .boolean = vars.getBoolean(operand) },
+                        .push_string_var => null,
+                        .push_string => .{ .string = self.strings[operand] },
+                        .push_number => .{ .number = self.numbers[operand] },
+                        else => unreachable,
+                    };
+                    len += 1;
+                },
+                .not => if (stack[len - 1]) |v| {
+                    stack[len - 1] = .{ .boolean = !v.boolean };
+                },
+                else => {
+                    const a = stack[len - 2];
+                    const b = stack[len - 1];
+                    len -= 1;
+                    stack[len - 1] = switch (op) {
+                        inline .@"and", .@"or" => |logic_op| _: {
+                            // the operand deciding the result on its own, false for and, true for or
+                            const decisive = logic_op == .@"or";
+                            if (a != null and a.?.boolean == decisive) break :_ a;
+                            if (b != null and b.?.boolean == decisive) break :_ b;
+                            break :_ if (a == null or b == null) null else a;
+                        },
+                        else => if (a == null or b == null) null else .{ .boolean = compare(op, a.?, b.?) },
+                    };
+                },
+            }
+        }
+
+        std.debug.assert(len == 1);
+        return if (stack[0]) |v| v.boolean else null;
+    }
+};
+
+fn compare(op: Op, a: Value, b: Value) bool {
+    return switch (op) {
+        .eq => a.eql(b),
+        .neq => !a.eql(b),
+        inline .lt, .lte, .gt, .gte => |cmp_op| _: {
+            const a_num = a.toNumber() orelse break :_ false;
+            const b_num = b.toNumber() orelse break :_ false;
+            break :_ switch (cmp_op) {
+                .lt => a_num < b_num,
+                .lte => a_num <= b_num,
+                .gt => a_num > b_num,
+                .gte => a_num >= b_num,
+                else => unreachable,
+            };
+        },
+        else => unreachable,
+    };
+}
+
+pub const CompileError = error{AlternisBadCondition} || std.mem.Allocator.Error;
+
+/// a description of why compiling failed
+pub const CompileDiagnostic = struct {
+    message: []const u8 = "",
+};
+
+const Type = enum { boolean, string, number };
+
+const Compiler = struct {
+    alloc: std.mem.Allocator,
+    boolean_vars: *const std.StringArrayHashMap(bool),
+    string_vars: *const std.StringArrayHashMap(StringVariable),
+    diagnostic: *CompileDiagnostic,
+
+    code: std.ArrayListUnmanaged(u8) = .{},
+    strings: std.ArrayListUnmanaged([]const u8) = .{},
+    numbers: std.ArrayListUnmanaged(f64) = .{},
+    read_booleans: std.ArrayListUnmanaged(usz) = .{},
+    reads_strings: bool = false,
+    depth: usize = 0,
+
+    fn fail(self: *@This(), message: []const u8) CompileError {
+        self.diagnostic.message = message;
+        return error.AlternisBadCondition;
+    }
+
+    fn emitPush(self: *@This(), op: Op, operand: usize) CompileError!void {
+        if (operand > std.math.maxInt(u16)) return self.fail("too many constants in condition");
+        if (self.depth == max_stack) return self.fail("condition is nested too deeply");
+        self.depth += 1;
+        try self.code.append(self.alloc, @intFromEnum(op));
+        var operand_bytes: [2]u8 = undefined;
+        std.mem.writeInt(u16, &operand_bytes, @intCast(operand), .little);
+        try self.code.appendSlice(self.alloc, &operand_bytes);
+    }
+
+    fn emitBinary(self: *@This(), op: Op) CompileError!void {
+        self.depth -= 1;
+        try self.code.append(self.alloc, @intFromEnum(op));
+    }
+
+    fn operands(self: *@This(), value: json.Value, comptime count: ?usize) CompileError![]const json.Value {
+        if (value != .array) return self.fail("expected an array of operands");
+        const items = value.array.items;
+        if (count) |c| {
+            if (items.len != c) return self.fail("wrong amount of operands");
+        } else if (items.len == 0) return self.fail("expected at least one operand");
+        return items;
+    }
+
+    fn expect(self: *@This(), expected: Type, actual: Type) CompileError!void {
+        if (expected != actual) return self.fail(switch (expected) {
+            .boolean => "expected a true/false operand",
+            .string => "expected a text operand",
+            .number => "expected a number operand",
+        });
+    }
+
+    fn compile(self: *@This(), expr: json.Value) CompileError!Type {
+        if (expr != .object or expr.object.count() != 1) return self.fail("an expression must be an object with one key");
+        const key = expr.object.keys()[0];
+        const arg = expr.object.values()[0];
+
+        if (std.mem.eql(u8, key, "var")) {
+            if (arg != .string) return self.fail("expected a variable name");
+            if (self.boolean_vars.getIndex(arg.string)) |var_index| {
+                if (std.mem.indexOfScalar(usz, self.read_booleans.items, @intCast(var_index)) == null)
+                    try self.read_booleans.append(self.alloc, @intCast(var_index));
+                try self.emitPush(.push_bool_var, var_index);
+                return .boolean;
+            }
+            if (self.string_vars.contains(arg.string)) {
+                self.reads_strings = true;
+                try self.strings.append(self.alloc, arg.string);
+                try self.emitPush(.push_string_var, self.strings.items.len - 1);
+                return .string;
+            }
+            return self.fail("no such variable");
+        }
+
+        if (std.mem.eql(u8, key, "str")) {
+            if (arg != .string) return self.fail("expected a string literal");
+            try self.strings.append(self.alloc, arg.string);
+            try self.emitPush(.push_string, self.strings.items.len - 1);
+            return .string;
+        }
+
+        if (std.mem.eql(u8, key, "num")) {
+            const number: f64 = switch (arg) {
+                .integer => |v| @floatFromInt(v),
+                .float => |v| v,
+                else => return self.fail("expected a number literal"),
+            };
+            try self.numbers.append(self.alloc, number);
+            try self.emitPush(.push_number, self.numbers.items.len - 1);
+            return .number;
+        }
+
+        if (std.mem.eql(u8, key, "not")) {
+            try self.expect(.boolean, try self.compile(arg));
+            try self.code.append(self.alloc, @intFromEnum(Op.not));
+            return .boolean;
+        }
+
+        inline for (.{ .{ "and", Op.@"and" }, .{ "or", Op.@"or" } }) |entry| {
+            if (std.mem.eql(u8, key, entry[0])) {
+                for (try self.operands(arg, null), 0..) |operand, i| {
+                    try self.expect(.boolean, try self.compile(operand));
+                    if (i > 0) try self.emitBinary(entry[1]);
+                }
+                return .boolean;
+            }
+        }
+
+        inline for (.{ .{ "eq", Op.eq }, .{ "neq", Op.neq } }) |entry| {
+            if (std.mem.eql(u8, key, entry[0])) {
+                const items = try self.operands(arg, 2);
+                try self.expect(try self.compile(items[0]), try self.compile(items[1]));
+                try self.emitBinary(entry[1]);
+                return .boolean;
+            }
+        }
+
+        inline for (.{ .{ "lt", Op.lt }, .{ "lte", Op.lte }, .{ "gt", Op.gt }, .{ "gte", Op.gte } }) |entry| {
+            if (std.mem.eql(u8, key, entry[0])) {
+                for (try self.operands(arg, 2)) |operand| {
+                    // string variables are parsed as numbers
+                    if (try self.compile(operand) == .boolean) return self.fail("expected a number operand");
+                }
+                try self.emitBinary(entry[1]);
+                return .boolean;
+            }
+        }
+
+        return self.fail("unknown expression");
+    }
+};
+
+/// compile an expression which must evaluate to true/false.
+/// Strings in the program refer to the json, so it must outlive the program
+pub fn compile(
+    alloc: std.mem.Allocator,
+    expr: json.Value,
+    boolean_vars: *const std.StringArrayHashMap(bool),
+    string_vars: *const std.StringArrayHashMap(StringVariable),
+    diagnostic: *CompileDiagnostic,
+) CompileError!Program {
+    var compiler = Compiler{
+        .alloc = alloc,
+        .boolean_vars = boolean_vars,
+        .string_vars = string_vars,
+        .diagnostic = diagnostic,
+    };
+    errdefer {
+        compiler.code.deinit(alloc);
+        compiler.strings.deinit(alloc);
+        compiler.numbers.deinit(alloc);
+        compiler.read_booleans.deinit(alloc);
+    }
+
+    try compiler.expect(.boolean, try compiler.compile(expr));
+
+    return Program{
+        .code = try compiler.code.toOwnedSlice(alloc),
+        .strings = try compiler.strings.toOwnedSlice(alloc),
+        .numbers = try compiler.numbers.toOwnedSlice(alloc),
+        .boolean_vars = try compiler.read_booleans.toOwnedSlice(alloc),
+        .reads_strings = compiler.reads_strings,
+    };
+}
+
+const t = std.testing;
+
+test "compile and evaluate conditions" {
+    var booleans = std.StringArrayHashMap(bool).init(t.allocator);
+    defer booleans.deinit();
+    try booleans.put("met the king", true);
+    try booleans.put("quest complete", false);
+
+    var strings = std.StringArrayHashMap(StringVariable).init(t.allocator);
+    defer strings.deinit();
+    try strings.put("name", StringVariable.unset);
+    try strings.put("gold", StringVariable.unset);
+    // short enough to not allocate
+    try strings.getPtr("name").?.set(t.allocator, "Arthur");
+    try strings.getPtr("gold").?.set(t.allocator, "12");
+
+    const Vars = struct {
+        booleans: *std.StringArrayHashMap(bool),
+        strings: *std.StringArrayHashMap(StringVariable),
+        pub fn getBoolean(self: @This(), index: usz) bool {
+            return self.booleans.values()[index];
+        }
+        pub fn getString(self: @This(), name: []const u8) []const u8 {
+            return self.strings.getPtr(name).?.slice();
+        }
+    };
+    const vars = Vars{ .booleans = &booleans, .strings = &strings };
+
+    const cases = [_]struct { []const u8, bool }{
+        .{ "{\"var\": \"met the king\"}", true },
+        .{ "{\"not\": {\"var\": \"met the king\"}}", false },
+        .{ "{\"and\": [{\"var\": \"met the king\"}, {\"not\": {\"var\": \"quest complete\"}}]}", true },
+        .{ "{\"or\": [{\"var\": \"quest complete\"}, {\"eq\": [{\"var\": \"name\"}, {\"str\": \"Arthur\"}]}]}", true },
+        .{ "{\"neq\": [{\"var\": \"name\"}, {\"str\": \"Arthur\"}]}", false },
+        .{ "{\"gte\": [{\"var\": \"gold\"}, {\"num\": 10}]}", true },
+        .{ "{\"lt\": [{\"var\": \"gold\"}, {\"num\": 2.5}]}", false },
+        // non-numeric strings never compare
+        .{ "{\"lt\": [{\"var\": \"name\"}, {\"num\": 2.5}]}", false },
+    };
+
+    for (cases) |case| {
+        const parsed = try json.parseFromSlice(json.Value, t.allocator, case[0], .{});
+        defer parsed.deinit();
+
+        var diagnostic = CompileDiagnostic{};
+        var arena = std.heap.ArenaAllocator.init(t.allocator);
+        defer arena.deinit();
+        const program = try compile(arena.allocator(), parsed.value, &booleans, &strings, &diagnostic);
+        try t.expectEqual(case[1], program.eval(vars));
+    }
+
+    const partial_cases = [_]struct { []const u8, ?bool }{
+        .{ "{\"and\": [{\"var\": \"met the king\"}, {\"not\": {\"var\": \"quest complete\"}}]}", true },
+        .{ "{\"and\": [{\"var\": \"quest complete\"}, {\"eq\": [{\"var\": \"name\"}, {\"str\": \"Arthur\"}]}]}", false },
+        .{ "{\"and\": [{\"var\": \"met the king\"}, {\"eq\": [{\"var\": \"name\"}, {\"str\": \"Arthur\"}]}]}", null },
+        .{ "{\"or\": [{\"gte\": [{\"var\": \"gold\"}, {\"num\": 10}]}, {\"var\": \"met the king\"}]}", true },
+        .{ "{\"or\": [{\"gte\": [{\"var\": \"gold\"}, {\"num\": 10}]}, {\"var\": \"quest complete\"}]}", null },
+        .{ "{\"not\": {\"neq\": [{\"var\": \"name\"}, {\"str\": \"Arthur\"}]}}", null },
+        .{ "{\"lt\": [{\"num\": 1}, {\"num\": 2}]}", true },
+    };
+
+    for (partial_cases) |case| {
+        const parsed = try json.parseFromSlice(json.Value, t.allocator, case[0], .{});
+        defer parsed.deinit();
+
+        var diagnostic = CompileDiagnostic{};
+        var arena = std.heap.ArenaAllocator.init(t.allocator);
+        defer arena.deinit();
+        const program = try compile(arena.allocator(), parsed.value, &booleans, &strings, &diagnostic);
+        try t.expectEqual(case[1], program.evalBooleans(vars));
+    }
+
+    {
+        const parsed = try json.parseFromSlice(json.Value, t.allocator, "{\"and\": [{\"var\": \"name\"}]}", .{});
+        defer parsed.deinit();
+        var diagnostic = CompileDiagnostic{};
+        try t.expectError(error.AlternisBadCondition, compile(t.allocator, parsed.value, &booleans, &strings, &diagnostic));
+        try t.expectEqualStrings("expected a true/false operand", diagnostic.message);
+    }
+}
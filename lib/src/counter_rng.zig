@@ -0,0 +1,52 @@
+//! A counter-based random generator: every draw is a pure function of the seed, a stream and
+//! the index of the draw in that stream, so there is no generator state to carry around.
+//! Each dialogue of a context draws from its own stream, so stepping one dialogue never changes
+//! the outcomes of another, dialogues may be stepped in any order and still draw the same, and
+//! restoring a dialogue's draws only takes its draw count. @see DialogueContext.randomDraws
+//!
+//! A stream is a SplitMix64 sequence whose starting state is the seed and stream mixed together,
+//! which makes the n-th draw one multiply-add and one mix away from the stream's key.
+
+const std = @import("std");
+
+const golden_gamma: u64 = 0x9e3779b97f4a7c15;
+
+/// the SplitMix64 finalizer, a bijective mix of all 64 bits
+fn mix(value: u64) u64 {
+    var z = value;
+    z = (z ^ (z >> 30)) *% 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) *% 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+/// the 64 random bits of the draw with index `counter` in `stream`
+pub fn bits(seed: u64, stream: u64, counter: u64) u64 {
+    const key = mix(seed ^ mix(stream +% golden_gamma));
+    return mix(key +% (counter +% 1) *% golden_gamma);
+}
+
+/// a float in [0, 1) from the draw, with the 24 high bits as its mantissa so every value is exact
+pub fn float(seed: u64, stream: u64, counter: u64) f32 {
+    return @as(f32, @floatFromInt(bits(seed, stream, counter) >> 40)) * 0x1.0p-24;
+}
+
+const t = std.testing;
+
+test "draws are a pure function of seed, stream and counter" {
+    try t.expectEqual(bits(0, 0, 0), bits(0, 0, 0));
+    try t.expect(bits(0, 0, 0) != bits(0, 0, 1));
+    try t.expect(bits(0, 0, 0) != bits(0, 1, 0));
+    try t.expect(bits(0, 0, 0) != bits(1, 0, 0));
+    // the stream isn't just an offset of the counter
+    try t.expect(bits(0, 1, 0) != bits(0, 0, 1));
+
+    var sum: f64 = 0;
+    const count = 10_000;
+    for (0..count) |i| {
+        const value = float(42, 3, i);
+        try t.expect(value >= 0 and value < 1);
+        sum += value;
+    }
+    // roughly uniform
+    try t.expectApproxEqAbs(@as(f64, 0.5), sum / count, 0.02);
+}
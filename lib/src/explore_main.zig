@@ -0,0 +1,85 @@
+//! alternis-explore: report which nodes and options of a dialogue file are reachable, which
+//! replies can leave the player without options, and which options can be offered together.
+
+const std = @import("std");
+const FileBuffer = @import("./FileBuffer.zig");
+const DialogueContext = @import("./main.zig").DialogueContext;
+const explorer = @import("./explorer.zig");
+
+const usage =
+    \\usage: alternis-explore [--threads N] [--all-false] <dialogue.alternis.json>
+    \\
+    \\Exhaustively explores every dialogue in the file.
+    \\  --threads N  the amount of threads to explore with, defaults to the amount of cores
+    \\  --all-false  start with every boolean variable false, instead of any possible value
+    \\
+;
+
+pub fn main() !u8 {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const alloc = gpa.allocator();
+
+    const args = try std.process.argsAlloc(alloc);
+    defer std.process.argsFree(alloc, args);
+
+    const stdout = std.io.getStdOut().writer();
+    const stderr = std.io.getStdErr().writer();
+
+    var opts = explorer.Opts{};
+    var path: ?[]const u8 = null;
+
+    var arg_index: usize = 1;
+    while (arg_index < args.len) : (arg_index += 1) {
+        const arg = args[arg_index];
+        if (std.mem.eql(u8, arg, "--threads")) {
+            arg_index += 1;
+            if (arg_index >= args.len) {
+                try stderr.writeAll(usage);
+                return 2;
+            }
+            opts.thread_count = std.fmt.parseInt(u32, args[arg_index], 10) catch {
+                try stderr.print("invalid thread count '{s}'\n", .{args[arg_index]});
+                return 2;
+            };
+        } else if (std.mem.eql(u8, arg, "--all-false")) {
+            opts.initial_booleans = .all_false;
+        } else if (std.mem.eql(u8, arg, "--help") or std.mem.eql(u8, arg, "-h")) {
+            try stdout.writeAll(usage);
+            return 0;
+        } else {
+            path = arg;
+        }
+    }
+
+    const dialogue = try FileBuffer.fromDirAndPath(alloc, std.fs.cwd(), path orelse {
+        try stderr.writeAll(usage);
+        return 2;
+    });
+    defer dialogue.free(alloc);
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    defer diagnostic.free(alloc);
+
+    var ctx = DialogueContext.initFromJson(dialogue.buffer, alloc, .{ .random_seed = 0, .no_interpolate = true }, &diagnostic) catch |e| {
+        try stderr.print("{}: {s}\n", .{ e, diagnostic.error_message.toZig() });
+        return 1;
+    };
+    defer ctx.deinit(alloc);
+
+    var failure = explorer.Failure{};
+    opts.failure = &failure;
+
+    var timer = try std.time.Timer.start();
+    var report = explorer.explore(&ctx, alloc, opts) catch |e| {
+        try stderr.writeAll("exploring failed: ");
+        try failure.write(e, stderr);
+        try stderr.writeByte('\n');
+        return 1;
+    };
+    defer report.deinit();
+
+    try report.write(stdout);
+    try stdout.print("explored in {d:.3}ms\n", .{@as(f64, @floatFromInt(timer.read())) / std.time.ns_per_ms});
+    return 0;
+}
@@ -0,0 +1,613 @@
+//! Headless exhaustive exploration of the compiled dialogue graph, for coverage analysis:
+//! which nodes are reachable, which options can never be chosen, where a player can get stuck,
+//! and which combinations of options can be offered at each choice.
+//!
+//! A state is a node and what is known about the boolean variables. Variables are three valued,
+//! either known true, known false, or unknown (e.g. set by the host before the dialogue started).
+//! At a reply node, the unknown variables its conditions read are split into each possible
+//! assignment, so that the options offered in each resulting state are exact, and choosing an
+//! option carries that knowledge forward. Random switches take every branch with a chance.
+//! String variables are abstracted away: a condition expression is evaluated three valued with
+//! every comparison reading a string unknown, and an option whose condition is unknown is assumed
+//! to be offered, while one that is false whatever the strings is not, e.g. {"and": [flag, eq]}
+//! with flag false. Calls are assumed not to touch variables.
+//!
+//! States are memoized in a sharded hash set, and each level of the breadth first search is
+//! expanded on a thread pool.
+
+const std = @import("std");
+const usz = @import("./config.zig").usz;
+const DialogueContext = @import("./main.zig").DialogueContext;
+
+pub const Opts = struct {
+    /// unknown explores every value the host could have given the variables before starting
+    initial_booleans: enum { unknown, all_false } = .unknown,
+    /// defaults to the amount of cores
+    thread_count: ?u32 = null,
+    /// stop with error.AlternisTooManyStates if a dialogue has more reachable states than this
+    max_states: usize = 50_000_000,
+    /// if set, receives the reply node which made exploring fail, @see Failure
+    failure: ?*Failure = null,
+};
+
+/// the reply node which exploring failed at, for the errors caused by a single node
+pub const Failure = struct {
+    dialogue: []const u8 = "",
+    node: usz = 0,
+
+    /// a message for QA explaining why the node can't be explored
+    pub fn write(self: @This(), err: ExploreError, writer: anytype) !void {
+        switch (err) {
+            error.AlternisTooManyOptions => try writer.print(
+                "reply node {} of dialogue '{s}' has more than {} options",
+                .{ self.node, self.dialogue, max_options },
+            ),
+            error.AlternisTooManySplitVariables => try writer.print(
+                "reply node {} of dialogue '{s}' reads more than {} true/false variables whose value is unknown",
+                .{ self.node, self.dialogue, max_split_vars },
+            ),
+            else => try writer.print("{}", .{err}),
+        }
+    }
+};
+
+pub const OptionRef = struct { node: usz, option: usz };
+
+pub const OptionCombinations = struct {
+    node: usz,
+    /// each distinct set of options offered at the node, bit n set if option n is offered
+    masks: []const u64,
+};
+
+pub const DialogueReport = struct {
+    name: []const u8,
+    state_count: usize,
+    unreachable_nodes: []const usz,
+    /// options which are not offered in any reachable state
+    dead_options: []const OptionRef,
+    /// reply nodes which are reachable in a state where none of their options are offered
+    dead_end_nodes: []const usz,
+    /// for each reachable reply node
+    option_combinations: []const OptionCombinations,
+};
+
+pub const Report = struct {
+    arena: std.heap.ArenaAllocator,
+    dialogues: []const DialogueReport,
+
+    pub fn deinit(self: *@This()) void {
+        self.arena.deinit();
+    }
+
+    pub fn write(self: @This(), writer: anytype) !void {
+        for (self.dialogues) |dialogue| {
+            try writer.print("dialogue '{s}': {} states explored\n", .{ dialogue.name, dialogue.state_count });
+
+            try writer.print("  unreachable nodes ({}):", .{dialogue.unreachable_nodes.len});
+            for (dialogue.unreachable_nodes) |node| try writer.print(" {}", .{node});
+            try writer.writeByte('\n');
+
+            try writer.print("  dead options ({}):", .{dialogue.dead_options.len});
+            for (dialogue.dead_options) |ref| try writer.print(" {}:{}", .{ ref.node, ref.option });
+            try writer.writeByte('\n');
+
+            try writer.print("  dead end replies ({}):", .{dialogue.dead_end_nodes.len});
+            for (dialogue.dead_end_nodes) |node| try writer.print(" {}", .{node});
+            try writer.writeByte('\n');
+
+            try writer.writeAll("  option combinations:\n");
+            for (dialogue.option_combinations) |combinations| {
+                try writer.print("    node {}:", .{combinations.node});
+                for (combinations.masks) |mask| try writer.print(" {b}", .{mask});
+                try writer.writeByte('\n');
+            }
+        }
+    }
+};
+
+pub const ExploreError = error{ AlternisTooManyStates, AlternisTooManyOptions, AlternisTooManySplitVariables } ||
+    std.mem.Allocator.Error || std.Thread.SpawnError;
+
+/// replies with more options than this are rejected
+const max_options = 64;
+/// replies reading more unknown variables than this are rejected, since each assignment is a state
+const max_split_vars = 16;
+
+const shard_count = 64;
+/// the minimum amount of states expanded per task
+const min_chunk_len = 64;
+
+/// a state is stored as [node, known words..., value words...]
+const State = []const u64;
+
+const StateContext = struct {
+    pub fn hash(_: @This(), state: State) u64 {
+        return std.hash.Wyhash.hash(0, std.mem.sliceAsBytes(state));
+    }
+    pub fn eql(_: @This(), a: State, b: State) bool {
+        return std.mem.eql(u64, a, b);
+    }
+};
+
+const Shard = struct {
+    mutex: std.Thread.Mutex = .{},
+    set: std.HashMapUnmanaged(State, void, StateContext, std.hash_map.default_max_load_percentage) = .{},
+    arena: std.heap.ArenaAllocator,
+};
+
+const Combination = struct { node: usz, mask: u64 };
+
+/// what one task found, merged after each level
+const TaskResult = struct {
+    next_states: std.ArrayListUnmanaged(State) = .{},
+    combinations: std.AutoHashMapUnmanaged(Combination, void) = .{},
+    err: ?ExploreError = null,
+    /// the node whose state failed to expand, if err is set
+    err_node: usz = 0,
+};
+
+/// the variables of a state, in which every variable an expression reads is known
+const StateVariables = struct {
+    explorer: *const Explorer,
+    state: []u64,
+
+    pub fn getBoolean(self: @This(), var_index: usz) bool {
+        return self.explorer.getVar(self.state, var_index).?;
+    }
+};
+
+/// the exploration of a single dialogue
+const Explorer = struct {
+    ctx: *const DialogueContext,
+    dialogue_id: usz,
+    /// thread safe
+    alloc: std.mem.Allocator,
+    opts: Opts,
+    word_count: usize,
+    shards: [shard_count]Shard,
+    state_count: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    reachable_nodes: []std.atomic.Value(u64),
+    dead_end_nodes: []std.atomic.Value(u64),
+    /// index of each lock/unlock node's variable, resolved once
+    node_var_indices: []const ?usz,
+
+    fn markNode(bits: []std.atomic.Value(u64), index: usize) void {
+        _ = bits[index / 64].fetchOr(@as(u64, 1) << @intCast(index % 64), .monotonic);
+    }
+
+    fn isMarked(bits: []std.atomic.Value(u64), index: usize) bool {
+        return bits[index / 64].load(.monotonic) & (@as(u64, 1) << @intCast(index % 64)) != 0;
+    }
+
+    /// returns the stored state if it was not yet visited
+    fn visit(self: *@This(), state: State) ExploreError!?State {
+        const shard = &self.shards[StateContext.hash(.{}, state) % shard_count];
+        shard.mutex.lock();
+        defer shard.mutex.unlock();
+
+        const entry = try shard.set.getOrPut(self.alloc, state);
+        if (entry.found_existing) return null;
+        errdefer shard.set.removeByPtr(entry.key_ptr);
+
+        if (self.state_count.fetchAdd(1, .monotonic) >= self.opts.max_states) return error.AlternisTooManyStates;
+
+        const stored = try shard.arena.allocator().dupe(u64, state);
+        entry.key_ptr.* = stored;
+        markNode(self.reachable_nodes, @intCast(state[0]));
+        return stored;
+    }
+
+    fn known(self: *const @This(), state: []u64) []u64 {
+        return state[1..][0..self.word_count];
+    }
+
+    fn values(self: *const @This(), state: []u64) []u64 {
+        return state[1 + self.word_count ..][0..self.word_count];
+    }
+
+    fn setVar(self: *const @This(), state: []u64, var_index: usize, value: bool) void {
+        const mask = @as(u64, 1) << @intCast(var_index % 64);
+        self.known(state)[var_index / 64] |= mask;
+        if (value) {
+            self.values(state)[var_index / 64] |= mask;
+        } else {
+            self.values(state)[var_index / 64] &= ~mask;
+        }
+    }
+
+    fn getVar(self: *const @This(), state: []u64, var_index: usize) ?bool {
+        const mask = @as(u64, 1) << @intCast(var_index % 64);
+        if (self.known(state)[var_index / 64] & mask == 0) return null;
+        return self.values(state)[var_index / 64] & mask != 0;
+    }
+
+    fn pushNext(self: *@This(), result: *TaskResult, scratch: []u64, next: anytype) ExploreError!void {
+        const next_index = next.toOptionalInt(usz) orelse return;
+        scratch[0] = next_index;
+        if (try self.visit(scratch)) |stored| try result.next_states.append(self.alloc, stored);
+    }
+
+    fn addSplitVar(self: *const @This(), state: []u64, split_vars: *std.BoundedArray(usz, max_split_vars), var_index: usz) ExploreError!void {
+        if (self.getVar(state, var_index) != null) return;
+        if (std.mem.indexOfScalar(usz, split_vars.slice(), var_index) != null) return;
+        split_vars.append(var_index) catch return error.AlternisTooManySplitVariables;
+    }
+
+    fn expand(self: *@This(), state: State, result: *TaskResult, scratch: []u64) ExploreError!void {
+        const node_index: usz = @intCast(state[0]);
+        const node = self.ctx.dialogues[self.dialogue_id].nodes.get(node_index);
+        @memcpy(scratch, state);
+
+        switch (node) {
+            .line => |v| try self.pushNext(result, scratch, v.next),
+            .call => |v| try self.pushNext(result, scratch, v.next),
+            .lock => |v| {
+                self.setVar(scratch, self.node_var_indices[node_index].?, false);
+                try self.pushNext(result, scratch, v.next);
+            },
+            .unlock => |v| {
+                self.setVar(scratch, self.node_var_indices[node_index].?, true);
+                try self.pushNext(result, scratch, v.next);
+            },
+            .random_switch => |v| for (v.nexts, v.chances) |next, chance| {
+                if (chance == 0) continue;
+                try self.pushNext(result, scratch, next);
+            },
+            .reply => |v| {
+                if (v.texts.len > max_options or v.nexts.len > max_options) return error.AlternisTooManyOptions;
+
+                // the unknown variables which the conditions read
+                var split_vars = std.BoundedArray(usz, max_split_vars){};
+                for (v.conditions) |cond| switch (cond) {
+                    .locked, .unlocked => |var_index| try self.addSplitVar(scratch, &split_vars, var_index),
+                    .expr => |program| for (program.boolean_vars) |var_index| try self.addSplitVar(scratch, &split_vars, var_index),
+                    .none => {},
+                };
+                const split_count = split_vars.len;
+
+                var assignment: u64 = 0;
+                while (assignment < (@as(u64, 1) << @intCast(split_count))) : (assignment += 1) {
+                    @memcpy(scratch, state);
+                    for (split_vars.slice(), 0..) |var_index, i|
+                        self.setVar(scratch, var_index, (assignment >> @intCast(i)) & 1 != 0);
+
+                    var mask: u64 = 0;
+                    for (v.conditions, 0..) |cond, option_index| {
+                        const offered = switch (cond) {
+                            .none => true,
+                            .locked => |var_index| !self.getVar(scratch, var_index).?,
+                            .unlocked => |var_index| self.getVar(scratch, var_index).?,
+                            // maybe offered, depending on strings, unless the booleans already decide
+                            .expr => |program| program.evalBooleans(StateVariables{ .explorer = self, .state = scratch }) orelse true,
+                        };
+                        if (offered) mask |= @as(u64, 1) << @intCast(option_index);
+                    }
+                    // replies without conditions offer every option
+                    if (v.conditions.len < v.texts.len)
+                        mask |= ~@as(u64, 0) << @intCast(v.conditions.len) & (~@as(u64, 0) >> @intCast(64 - v.texts.len));
+
+                    try result.combinations.put(self.alloc, .{ .node = node_index, .mask = mask }, {});
+                    if (mask == 0) markNode(self.dead_end_nodes, node_index);
+
+                    for (v.nexts, 0..) |next, option_index| {
+                        if (mask & (@as(u64, 1) << @intCast(option_index)) == 0) continue;
+                        try self.pushNext(result, scratch, next);
+                    }
+                }
+            },
+        }
+    }
+
+    fn expandChunk(self: *@This(), states: []const State, result: *TaskResult, wait_group: *std.Thread.WaitGroup) void {
+        defer wait_group.finish();
+        const scratch = self.alloc.alloc(u64, 1 + 2 * self.word_count) catch |e| {
+            result.err = e;
+            return;
+        };
+        defer self.alloc.free(scratch);
+        for (states) |state| self.expand(state, result, scratch) catch |e| {
+            result.err = e;
+            result.err_node = @intCast(state[0]);
+            return;
+        };
+    }
+};
+
+/// explore every dialogue of the context, which is only read and may not be stepped meanwhile
+pub fn explore(ctx: *const DialogueContext, in_alloc: std.mem.Allocator, opts: Opts) ExploreError!Report {
+    var thread_safe_alloc = std.heap.ThreadSafeAllocator{ .child_allocator = in_alloc };
+    const alloc = thread_safe_alloc.allocator();
+
+    var report_arena = std.heap.ArenaAllocator.init(in_alloc);
+    errdefer report_arena.deinit();
+    const report_alloc = report_arena.allocator();
+
+    var pool: std.Thread.Pool = undefined;
+    try pool.init(.{ .allocator = alloc, .n_jobs = opts.thread_count });
+    defer pool.deinit();
+
+    const dialogue_reports = try report_alloc.alloc(DialogueReport, ctx.dialogues.len);
+    for (dialogue_reports, 0..) |*dialogue_report, dialogue_id|
+        dialogue_report.* = try exploreDialogue(ctx, @intCast(dialogue_id), alloc, report_alloc, &pool, opts);
+
+    return Report{ .arena = report_arena, .dialogues = dialogue_reports };
+}
+
+fn exploreDialogue(
+    ctx: *const DialogueContext,
+    dialogue_id: usz,
+    alloc: std.mem.Allocator,
+    report_alloc: std.mem.Allocator,
+    pool: *std.Thread.Pool,
+    opts: Opts,
+) ExploreError!DialogueReport {
+    const dialogue = &ctx.dialogues[dialogue_id];
+    const node_count = dialogue.nodes.len;
+    const node_words = std.math.divCeil(usize, @max(node_count, 1), 64) catch unreachable;
+    const var_count = ctx.variables.booleans.count();
+
+    var self = Explorer{
+        .ctx = ctx,
+        .dialogue_id = dialogue_id,
+        .alloc = alloc,
+        .opts = opts,
+        .word_count = std.math.divCeil(usize, @max(var_count, 1), 64) catch unreachable,
+        .shards = undefined,
+        .reachable_nodes = try alloc.alloc(std.atomic.Value(u64), node_words),
+        .dead_end_nodes = try alloc.alloc(std.atomic.Value(u64), node_words),
+        .node_var_indices = &.{},
+    };
+    defer alloc.free(self.reachable_nodes);
+    defer alloc.free(self.dead_end_nodes);
+    for (self.reachable_nodes, self.dead_end_nodes) |*a, *b| {
+        a.* = std.atomic.Value(u64).init(0);
+        b.* = std.atomic.Value(u64).init(0);
+    }
+
+    for (&self.shards) |*shard| shard.* = .{ .arena = std.heap.ArenaAllocator.init(alloc) };
+    defer for (&self.shards) |*shard| {
+        shard.set.deinit(alloc);
+        shard.arena.deinit();
+    };
+
+    const node_var_indices = try alloc.alloc(?usz, node_count);
+    defer alloc.free(node_var_indices);
+    for (node_var_indices, 0..) |*var_index, node_index| var_index.* = switch (dialogue.nodes.get(node_index)) {
+        inline .lock, .unlock => |v| @as(usz, @intCast(ctx.variables.booleans.getIndex(v.boolean_var_name) orelse
+            std.debug.panic("no such boolean variable: '{s}'", .{v.boolean_var_name}))),
+        else => null,
+    };
+    self.node_var_indices = node_var_indices;
+
+    var combinations = std.AutoArrayHashMapUnmanaged(Combination, void){};
+    defer combinations.deinit(alloc);
+
+    if (node_count > 0) {
+        const initial = try alloc.alloc(u64, 1 + 2 * self.word_count);
+        defer alloc.free(initial);
+        @memset(initial, 0);
+        if (opts.initial_booleans == .all_false) for (0..var_count) |var_index| self.setVar(initial, var_index, false);
+
+        var frontier = std.ArrayListUnmanaged(State){};
+        defer frontier.deinit(alloc);
+        try frontier.append(alloc, (try self.visit(initial)).?);
+
+        var task_results = std.ArrayListUnmanaged(TaskResult){};
+        defer task_results.deinit(alloc);
+
+        while (frontier.items.len > 0) {
+            const target_tasks = @max(pool.threads.len, 1) * 4;
+            const chunk_len = @max(min_chunk_len, std.math.divCeil(usize, frontier.items.len, target_tasks) catch unreachable);
+            const task_count = std.math.divCeil(usize, frontier.items.len, chunk_len) catch unreachable;
+
+            try task_results.resize(alloc, task_count);
+            for (task_results.items) |*task_result| task_result.* = .{};
+            defer for (task_results.items) |*task_result| {
+                task_result.next_states.deinit(alloc);
+                task_result.combinations.deinit(alloc);
+            };
+
+            var wait_group = std.Thread.WaitGroup{};
+            var spawn_err: ?ExploreError = null;
+            for (task_results.items, 0..) |*task_result, task_index| {
+                const chunk = frontier.items[task_index * chunk_len .. @min((task_index + 1) * chunk_len, frontier.items.len)];
+                wait_group.start();
+                pool.spawn(Explorer.expandChunk, .{ &self, chunk, task_result, &wait_group }) catch |e| {
+                    wait_group.finish();
+                    spawn_err = e;
+                    break;
+                };
+            }
+            // spawned tasks refer to this frame, so they must finish even on error
+            pool.waitAndWork(&wait_group);
+            if (spawn_err) |e| return e;
+
+            frontier.clearRetainingCapacity();
+            for (task_results.items) |*task_result| {
+                if (task_result.err) |e| {
+                    if (opts.failure) |failure| failure.* = .{ .dialogue = dialogue.name, .node = task_result.err_node };
+                    return e;
+                }
+                try frontier.appendSlice(alloc, task_result.next_states.items);
+                var iter = task_result.combinations.keyIterator();
+                while (iter.next()) |combination| try combinations.put(alloc, combination.*, {});
+            }
+        }
+    }
+
+    // build the report
+    var unreachable_nodes = std.ArrayList(usz).init(report_alloc);
+    var dead_end_nodes = std.ArrayList(usz).init(report_alloc);
+    for (0..node_count) |node_index| {
+        if (!Explorer.isMarked(self.reachable_nodes, node_index)) try unreachable_nodes.append(@intCast(node_index));
+        if (Explorer.isMarked(self.dead_end_nodes, node_index)) try dead_end_nodes.append(@intCast(node_index));
+    }
+
+    const SortContext = struct {
+        keys: []const Combination,
+        pub fn lessThan(sort_ctx: @This(), a: usize, b: usize) bool {
+            const ka = sort_ctx.keys[a];
+            const kb = sort_ctx.keys[b];
+            return ka.node < kb.node or (ka.node == kb.node and ka.mask < kb.mask);
+        }
+    };
+    combinations.sort(SortContext{ .keys = combinations.keys() });
+
+    var option_combinations = std.ArrayList(OptionCombinations).init(report_alloc);
+    var dead_options = std.ArrayList(OptionRef).init(report_alloc);
+    const keys = combinations.keys();
+    var start: usize = 0;
+    while (start < keys.len) {
+        const node_index = keys[start].node;
+        var end = start;
+        var offered: u64 = 0;
+        while (end < keys.len and keys[end].node == node_index) : (end += 1) offered |= keys[end].mask;
+
+        const masks = try report_alloc.alloc(u64, end - start);
+        for (masks, keys[start..end]) |*mask, key| mask.* = key.mask;
+        try option_combinations.append(.{ .node = node_index, .masks = masks });
+
+        const option_count = dialogue.nodes.items(.data)[node_index].reply.texts.len;
+        for (0..option_count) |option_index| if (offered & (@as(u64, 1) << @intCast(option_index)) == 0)
+            try dead_options.append(.{ .node = node_index, .option = @intCast(option_index) });
+
+        start = end;
+    }
+
+    // reachable replies always have combinations, so unreachable ones only need their options listed
+    for (unreachable_nodes.items) |node_index| {
+        if (dialogue.nodes.items(.tags)[node_index] != .reply) continue;
+        for (0..dialogue.nodes.items(.data)[node_index].reply.texts.len) |option_index|
+            try dead_options.append(.{ .node = node_index, .option = @intCast(option_index) });
+    }
+
+    return DialogueReport{
+        .name = dialogue.name,
+        .state_count = self.state_count.load(.monotonic),
+        .unreachable_nodes = try unreachable_nodes.toOwnedSlice(),
+        .dead_options = try dead_options.toOwnedSlice(),
+        .dead_end_nodes = try dead_end_nodes.toOwnedSlice(),
+        .option_combinations = try option_combinations.toOwnedSlice(),
+    };
+}
+
+const t = std.testing;
+
+test "explore reachability and options" {
+    const src =
+        \\{"version": 1, "dialogues": {"d": {"nodes": [
+        \\  {"reply": {"nexts": [1, 2], "texts": [{"speaker": "a", "text": "x"}, {"speaker": "a", "text": "y"}],
+        \\    "conditions": [{"action": "none"}, {"action": "unlocked", "variable": "flag"}]}},
+        \\  {"unlock": {"boolean_var_name": "flag", "next": 0}},
+        \\  {"line": {"data": {"speaker": "a", "text": "two"}}},
+        \\  {"line": {"data": {"speaker": "a", "text": "never"}}}
+        \\]}}, "variables": {"boolean": [{"name": "flag"}]}}
+    ;
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+    var ctx = try DialogueContext.initFromJson(src, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer ctx.deinit(t.allocator);
+
+    {
+        var report = try explore(&ctx, t.allocator, .{ .initial_booleans = .all_false, .thread_count = 2 });
+        defer report.deinit();
+        const dialogue = report.dialogues[0];
+        try t.expectEqualSlices(usz, &.{3}, dialogue.unreachable_nodes);
+        try t.expectEqual(@as(usize, 0), dialogue.dead_options.len);
+        try t.expectEqual(@as(usize, 0), dialogue.dead_end_nodes.len);
+        try t.expectEqual(@as(usize, 1), dialogue.option_combinations.len);
+        // only the first option before unlocking, both after
+        try t.expectEqualSlices(u64, &.{ 0b01, 0b11 }, dialogue.option_combinations[0].masks);
+    }
+
+    {
+        const no_unlock_src = try std.mem.replaceOwned(u8, t.allocator, src, "\"unlock\"", "\"lock\"");
+        defer t.allocator.free(no_unlock_src);
+        var locked_ctx = try DialogueContext.initFromJson(no_unlock_src, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+        defer locked_ctx.deinit(t.allocator);
+
+        var report = try explore(&locked_ctx, t.allocator, .{ .initial_booleans = .all_false });
+        defer report.deinit();
+        const dialogue = report.dialogues[0];
+        try t.expectEqualSlices(usz, &.{ 2, 3 }, dialogue.unreachable_nodes);
+        try t.expectEqual(@as(usize, 1), dialogue.dead_options.len);
+        try t.expectEqual(OptionRef{ .node = 0, .option = 1 }, dialogue.dead_options[0]);
+    }
+}
+
+test "conditions reading strings are offered unless their booleans decide" {
+    const src =
+        \\{"version": 1, "dialogues": {"d": {"nodes": [
+        \\  {"reply": {"nexts": [1, 1, 1], "texts": [{"speaker": "a", "text": "x"}, {"speaker": "a", "text": "y"}, {"speaker": "a", "text": "z"}],
+        \\    "conditions": [
+        \\      {"action": "expr", "expr": {"and": [{"var": "flag"}, {"eq": [{"var": "name"}, {"str": "x"}]}]}},
+        \\      {"action": "expr", "expr": {"or": [{"var": "flag"}, {"eq": [{"var": "name"}, {"str": "x"}]}]}},
+        \\      {"action": "none"}
+        \\    ]}},
+        \\  {"line": {"data": {"speaker": "a", "text": "end"}}}
+        \\]}}, "variables": {"boolean": [{"name": "flag"}], "string": [{"name": "name"}]}}
+    ;
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+    var ctx = try DialogueContext.initFromJson(src, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer ctx.deinit(t.allocator);
+
+    {
+        var report = try explore(&ctx, t.allocator, .{ .initial_booleans = .all_false });
+        defer report.deinit();
+        const dialogue = report.dialogues[0];
+        // flag false decides the and without the name, while the or depends on it
+        try t.expectEqual(@as(usize, 1), dialogue.dead_options.len);
+        try t.expectEqual(OptionRef{ .node = 0, .option = 0 }, dialogue.dead_options[0]);
+        try t.expectEqualSlices(u64, &.{0b110}, dialogue.option_combinations[0].masks);
+    }
+
+    {
+        var report = try explore(&ctx, t.allocator, .{ .initial_booleans = .unknown });
+        defer report.deinit();
+        const dialogue = report.dialogues[0];
+        try t.expectEqual(@as(usize, 0), dialogue.dead_options.len);
+        try t.expectEqualSlices(u64, &.{ 0b110, 0b111 }, dialogue.option_combinations[0].masks);
+    }
+}
+
+test "replies reading too many unknown variables name the node" {
+    var src = std.ArrayList(u8).init(t.allocator);
+    defer src.deinit();
+    const var_count = max_split_vars + 1;
+
+    try src.appendSlice(
+        \\{"version": 1, "dialogues": {"d": {"nodes": [
+        \\  {"line": {"data": {"speaker": "a", "text": "x"}, "next": 1}},
+        \\  {"reply": {"nexts": [
+    );
+    for (0..var_count) |i| try src.appendSlice(if (i == 0) "null" else ", null");
+    try src.appendSlice("], \"texts\": [");
+    for (0..var_count) |i| try src.writer().print("{s}{{\"speaker\": \"a\", \"text\": \"{}\"}}", .{ if (i == 0) "" else ", ", i });
+    try src.appendSlice("], \"conditions\": [");
+    for (0..var_count) |i| try src.writer().print("{s}{{\"action\": \"unlocked\", \"variable\": \"v{}\"}}", .{ if (i == 0) "" else ", ", i });
+    try src.appendSlice("]}}]}}, \"variables\": {\"boolean\": [");
+    for (0..var_count) |i| try src.writer().print("{s}{{\"name\": \"v{}\"}}", .{ if (i == 0) "" else ", ", i });
+    try src.appendSlice("]}}");
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+    var ctx = try DialogueContext.initFromJson(src.items, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer ctx.deinit(t.allocator);
+
+    var failure = Failure{};
+    try t.expectError(error.AlternisTooManySplitVariables, explore(&ctx, t.allocator, .{ .failure = &failure }));
+    try t.expectEqual(@as(usz, 1), failure.node);
+    try t.expectEqualStrings("d", failure.dialogue);
+
+    var message = std.ArrayList(u8).init(t.allocator);
+    defer message.deinit();
+    try failure.write(error.AlternisTooManySplitVariables, message.writer());
+    try t.expectEqualStrings("reply node 1 of dialogue 'd' reads more than 16 true/false variables whose value is unknown", message.items);
+
+    // known variables aren't split, so the same reply explores fine
+    var report = try explore(&ctx, t.allocator, .{ .initial_booleans = .all_false });
+    report.deinit();
+}
@@ -0,0 +1,186 @@
+//! A small LZ77 block codec in the style of LZ4, for compressing the texts of a dialogue file
+//! without a dependency. Favors decompression speed over ratio: a block is a run of sequences,
+//! each a token byte, literals copied as-is, and a back reference into the already decompressed
+//! output. The decompressed size is not stored, the caller keeps it beside the block.
+//!
+//! sequence := token, [literal length bytes], literals, offset (u16 le), [match length bytes]
+//! where the token's high nibble is the literal length and its low nibble the match length
+//! minus min_match, either continued by bytes of 255 and a final byte below 255 when it is 15.
+//! The last sequence of a block ends after its literals.
+
+const std = @import("std");
+
+pub const DecompressError = error{CorruptInput};
+
+const min_match = 4;
+const max_offset = std.math.maxInt(u16);
+const hash_bits = 12;
+
+/// the most bytes that compressing `len` bytes can produce
+pub fn compressBound(len: usize) usize {
+    return len + len / 255 + 16;
+}
+
+fn hash(sequence: u32) usize {
+    return @intCast((sequence *% 2654435761) >> (32 - hash_bits));
+}
+
+/// compress `input` into `out`, which must be at least compressBound(input.len) long,
+/// and return the compressed length. Input must be shorter than 4GiB
+pub fn compress(input: []const u8, out: []u8) usize {
+    std.debug.assert(out.len >= compressBound(input.len));
+    std.debug.assert(input.len < std.math.maxInt(u32));
+
+    // the last position + 1 of each hashed 4 bytes, 0 if none yet
+    var table = [_]u32{0} ** (1 << hash_bits);
+    var pos: usize = 0;
+    var anchor: usize = 0;
+    var out_len: usize = 0;
+
+    while (pos + min_match <= input.len) {
+        const sequence = std.mem.readInt(u32, input[pos..][0..4], .little);
+        const slot = &table[hash(sequence)];
+        const candidate = slot.*;
+        slot.* = @intCast(pos + 1);
+
+        if (candidate != 0) {
+            const ref = candidate - 1;
+            if (pos - ref <= max_offset and std.mem.readInt(u32, input[ref..][0..4], .little) == sequence) {
+                var match_len: usize = min_match;
+                while (pos + match_len < input.len and input[ref + match_len] == input[pos + match_len])
+                    match_len += 1;
+
+                out_len = writeSequence(out, out_len, input[anchor..pos], .{ .offset = @intCast(pos - ref), .len = match_len });
+                pos += match_len;
+                anchor = pos;
+                continue;
+            }
+        }
+        pos += 1;
+    }
+
+    return writeSequence(out, out_len, input[anchor..], null);
+}
+
+const Match = struct { offset: u16, len: usize };
+
+fn writeSequence(out: []u8, start: usize, literals: []const u8, match: ?Match) usize {
+    var out_len = start;
+    const match_nibble: usize = if (match) |m| m.len - min_match else 0;
+    const literal_bits: u8 = @intCast(@min(literals.len, 15));
+    const match_bits: u8 = @intCast(@min(match_nibble, 15));
+    out[out_len] = literal_bits << 4 | match_bits;
+    out_len += 1;
+
+    if (literals.len >= 15) out_len = writeLength(out, out_len, literals.len - 15);
+    @memcpy(out[out_len..][0..literals.len], literals);
+    out_len += literals.len;
+
+    if (match) |m| {
+        std.mem.writeInt(u16, out[out_len..][0..2], m.offset, .little);
+        out_len += 2;
+        if (match_nibble >= 15) out_len = writeLength(out, out_len, match_nibble - 15);
+    }
+    return out_len;
+}
+
+fn writeLength(out: []u8, start: usize, len: usize) usize {
+    var out_len = start;
+    var rest = len;
+    while (rest >= 255) : (rest -= 255) {
+        out[out_len] = 255;
+        out_len += 1;
+    }
+    out[out_len] = @intCast(rest);
+    return out_len + 1;
+}
+
+fn readLength(input: []const u8, pos: *usize) DecompressError!usize {
+    var len: usize = 0;
+    while (true) {
+        if (pos.* >= input.len) return error.CorruptInput;
+        const byte = input[pos.*];
+        pos.* += 1;
+        len += byte;
+        if (byte != 255) return len;
+    }
+}
+
+/// decompress a block into `out`, whose length must be exactly the decompressed size.
+/// Never reads or writes out of bounds, even for corrupt input
+pub fn decompress(input: []const u8, out: []u8) DecompressError!void {
+    var pos: usize = 0;
+    var out_len: usize = 0;
+
+    while (true) {
+        if (pos >= input.len) return error.CorruptInput;
+        const token = input[pos];
+        pos += 1;
+
+        var literal_len: usize = token >> 4;
+        if (literal_len == 15) literal_len += try readLength(input, &pos);
+        if (literal_len > input.len - pos or literal_len > out.len - out_len) return error.CorruptInput;
+        @memcpy(out[out_len..][0..literal_len], input[pos..][0..literal_len]);
+        pos += literal_len;
+        out_len += literal_len;
+
+        if (pos == input.len) break;
+
+        if (input.len - pos < 2) return error.CorruptInput;
+        const offset = std.mem.readInt(u16, input[pos..][0..2], .little);
+        pos += 2;
+        var match_len: usize = (token & 15) + min_match;
+        if (token & 15 == 15) match_len += try readLength(input, &pos);
+        if (offset == 0 or offset > out_len or match_len > out.len - out_len) return error.CorruptInput;
+
+        // byte by byte, since the match may overlap what it is copying, e.g. a run of one byte
+        for (out[out_len..][0..match_len], out_len - offset..) |*byte, from| byte.* = out[from];
+        out_len += match_len;
+    }
+
+    if (out_len != out.len) return error.CorruptInput;
+}
+
+const t = std.testing;
+
+fn expectRoundTrip(input: []const u8) !usize {
+    const compressed = try t.allocator.alloc(u8, compressBound(input.len));
+    defer t.allocator.free(compressed);
+    const compressed_len = compress(input, compressed);
+
+    const decompressed = try t.allocator.alloc(u8, input.len);
+    defer t.allocator.free(decompressed);
+    try decompress(compressed[0..compressed_len], decompressed);
+    try t.expectEqualSlices(u8, input, decompressed);
+    return compressed_len;
+}
+
+test "round trip" {
+    _ = try expectRoundTrip("");
+    _ = try expectRoundTrip("abc");
+    _ = try expectRoundTrip("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+
+    var text = std.ArrayList(u8).init(t.allocator);
+    defer text.deinit();
+    for (0..200) |i| try text.writer().print("Aaron: What was your name again, {s}? ({})\n", .{ if (i % 3 == 0) "Testy" else "stranger", i % 7 });
+    const compressed_len = try expectRoundTrip(text.items);
+    try t.expect(compressed_len * 4 < text.items.len);
+
+    // incompressible input grows by no more than the bound
+    var random_bytes: [5000]u8 = undefined;
+    var prng = std.rand.DefaultPrng.init(0);
+    prng.random().bytes(&random_bytes);
+    try t.expect(try expectRoundTrip(&random_bytes) <= compressBound(random_bytes.len));
+}
+
+test "corrupt input is rejected" {
+    var out: [16]u8 = undefined;
+    try t.expectError(error.CorruptInput, decompress("", &out));
+    // a reference before the start of the output
+    try t.expectError(error.CorruptInput, decompress(&.{ 0x10, 'a', 5, 0, 0 }, &out));
+    // literals past the end of the input
+    try t.expectError(error.CorruptInput, decompress(&.{ 0xf0, 200 }, &out));
+    // wrong decompressed size
+    try t.expectError(error.CorruptInput, decompress(&.{ 0x10, 'a' }, &out));
+    try decompress(&.{ 0x10, 'a' }, out[0..1]);
+}
@@ -9,6 +9,16 @@ const FileBuffer = @import("./FileBuffer.zig");
 const text_interp = @import("./text_interp.zig");
 const usz = @import("./config.zig").usz;
 const StringPool = @import("./StringPool.zig");
+const text_encoding = @import("./text_encoding.zig");
+pub const TextEncoding = text_encoding.TextEncoding;
+pub const WorldState = @import("./WorldState.zig");
+pub const trace = @import("./trace.zig");
+pub const EventRing = @import("./EventRing.zig");
+pub const ChangeLog = @import("./ChangeLog.zig");
+const condition_vm = @import("./condition_vm.zig");
+const StringVariable = @import("./StringVariable.zig");
+const TextStore = @import("./TextStore.zig");
+const counter_rng = @import("./counter_rng.zig");
 
 // FIXME: only in wasm
 extern fn _debug_print([*]const u8, len: usize) void;
@@ -46,24 +56,37 @@ test "next toOptionalInt" {
     try t.expectEqual((Next{ .valid = false, .value = 1 }).toOptionalInt(u32), null);
 }
 
-const Line = extern struct {
+pub const Line = extern struct {
     speaker: Slice(u8),
     text: Slice(u8),
     metadata: OptSlice(u8) = .{},
 
-    /// free the text, since it is allocated for formatting
-    pub fn free(self: *@This(), alloc: std.mem.Allocator) void {
-        alloc.free(self.text.toZig());
-    }
-
-    // the returned Line must be freed
-    pub fn interpolate(self: @This(), alloc: std.mem.Allocator, vars: *std.StringHashMap([]const u8)) Line {
+    /// the text is interpolated as utf8 and then transcoded to the output encoding, into `alloc`,
+    /// which is the context's scratch arena so the text is freed with its next reset
+    pub fn interpolate(self: @This(), alloc: std.mem.Allocator, vars: anytype, encoding: TextEncoding) Line {
+        const interpolated = text_interp.interpolate_template(self.text.toZig(), alloc, vars) catch |e| std.debug.panic("error: '{}', perhaps a bad variable reference?", .{e});
         return Line{
             .speaker = self.speaker,
-            .text = Slice(u8).fromZig(text_interp.interpolate_template(self.text.toZig(), alloc, vars) catch |e| std.debug.panic("error: '{}', perhaps a bad variable reference?", .{e})),
+            .text = Slice(u8).fromZig(switch (encoding) {
+                .utf8 => interpolated,
+                .utf16 => _: {
+                    defer alloc.free(interpolated);
+                    break :_ text_encoding.utf8ToUtf16LeBytes(alloc, interpolated) catch |e| std.debug.panic("error: '{}' transcoding interpolated text", .{e});
+                },
+            }),
             .metadata = self.metadata,
         };
     }
+
+    /// transcode the line to the given output encoding ahead of time,
+    /// the text is left as utf8 if `include_text` is false, since templates are interpolated as utf8
+    pub fn encode(self: @This(), alloc: std.mem.Allocator, encoding: TextEncoding, include_text: bool) !Line {
+        return Line{
+            .speaker = Slice(u8).fromZig(try text_encoding.encode(alloc, self.speaker.toZig(), encoding)),
+            .text = if (include_text) Slice(u8).fromZig(try text_encoding.encode(alloc, self.text.toZig(), encoding)) else self.text,
+            .metadata = if (self.metadata.toZig()) |metadata| OptSlice(u8).fromZig(try text_encoding.encode(alloc, metadata, encoding)) else self.metadata,
+        };
+    }
 };
 
 const RandomSwitch = struct {
@@ -76,11 +99,24 @@ const RandomSwitch = struct {
         for (chances) |chance| total_chances += chance;
         return .{ .nexts = nexts, .chances = chances, .total_chances = total_chances };
     }
+
+    /// the next of the branch which a draw in [0, 1) lands on
+    fn choose(self: @This(), shot: f32) Next {
+        var acc: u64 = 0;
+        for (self.nexts, self.chances) |next, chance_count| {
+            acc += chance_count;
+            const chance_proportion = @as(f64, @floatFromInt(acc)) / @as(f64, @floatFromInt(self.total_chances));
+            if (shot < chance_proportion) return next;
+        }
+
+        // just in case of fp error
+        std.debug.assert(self.nexts.len >= 1);
+        return self.nexts[self.nexts.len - 1];
+    }
 };
 
-const stupid_hack = false;
 // REPORT/FIXME: just pull out the type... zig complained about indexing into an empty slice
-const ConditionType = @TypeOf((Reply{ .conditions = &.{.{ .locked = &stupid_hack }} }).conditions[0]);
+const ConditionType = @TypeOf((Reply{ .conditions = &.{.{ .locked = 0 }} }).conditions[0]);
 
 const Reply = struct {
     nexts: []const Next = &.{}, // does it make sense for these to be optional?
@@ -90,26 +126,37 @@ const Reply = struct {
 
     conditions: []const union(enum) {
         none,
-        /// if the pointed to variable is locked (false), allowed
-        /// pointer to the backing bool which should be stable
-        locked: *const bool,
-        /// if the pointed to variable is unlocked (true), allowed
-        /// pointer to the backing bool which should be stable
-        unlocked: *const bool,
+        /// if the indexed boolean variable is locked (false), allowed
+        /// an index (not a pointer) so that contexts sharing these nodes each read their own variables
+        locked: usz,
+        /// if the indexed boolean variable is unlocked (true), allowed
+        unlocked: usz,
+        /// if the compiled expression evaluates to true, allowed
+        expr: *const condition_vm.Program,
     } = &.{},
 
+    /// expressions are compiled into `program_alloc`
     fn initFromJson(
         alloc: std.mem.Allocator,
+        program_alloc: std.mem.Allocator,
         reply_json: ReplyJson,
-        boolean_vars: *std.StringHashMap(bool),
-    ) @This() {
+        boolean_vars: *const std.StringArrayHashMap(bool),
+        string_vars: *const std.StringArrayHashMap(StringVariable),
+        diagnostic: *condition_vm.CompileDiagnostic,
+    ) condition_vm.CompileError!@This() {
         // FIXME: leak
         const conditions = alloc.alloc(ConditionType, reply_json.conditions.len) catch unreachable;
+        errdefer alloc.free(conditions);
 
         for (reply_json.conditions, conditions) |json_cond, *self| self.* = switch (json_cond.action) {
             .none => .none,
-            .locked => .{ .locked = boolean_vars.getPtr(json_cond.variable.?).? },
-            .unlocked => .{ .unlocked = boolean_vars.getPtr(json_cond.variable.?).? },
+            .locked => .{ .locked = @intCast(boolean_vars.getIndex(json_cond.variable.?).?) },
+            .unlocked => .{ .unlocked = @intCast(boolean_vars.getIndex(json_cond.variable.?).?) },
+            .expr => _: {
+                const program = try program_alloc.create(condition_vm.Program);
+                program.* = try condition_vm.compile(program_alloc, json_cond.expr.?, boolean_vars, string_vars, diagnostic);
+                break :_ .{ .expr = program };
+            },
         };
 
         return .{
@@ -140,6 +187,26 @@ const Node = union(enum) {
         function_name: []const u8,
         next: Next = .{},
     },
+
+    /// transcode the static texts of the node to the output encoding ahead of time,
+    /// so that stepping doesn't need to. Texts which will be interpolated stay utf8
+    /// and are transcoded after interpolation when stepping
+    fn encodeTexts(self: @This(), alloc: std.mem.Allocator, encoding: TextEncoding, interpolated: bool) !@This() {
+        if (encoding == .utf8) return self;
+
+        var result = self;
+        switch (result) {
+            .line => |*v| v.data = try v.data.encode(alloc, encoding, !interpolated),
+            .reply => |*v| {
+                const texts = try alloc.alloc(Line, v.texts.len);
+                for (texts, v.texts.toZig()) |*encoded, text|
+                    encoded.* = try text.encode(alloc, encoding, !interpolated);
+                v.texts = Slice(Line).fromZig(texts);
+            },
+            else => {},
+        }
+        return result;
+    }
 };
 
 /// A function implemented by the environment
@@ -157,20 +224,382 @@ const VariableType = enum {
     boolean,
 };
 
+/// the context's view of a shared world state
+const WorldBinding = struct {
+    state: *WorldState,
+    /// for each of the context's boolean variables, the index of the world variable of the same name, if any
+    booleans: []const ?usz,
+    /// the context's registration for reading world strings, unregistered by the context's deinit
+    reader: *WorldState.Reader,
+
+    fn init(state: *WorldState, alloc: std.mem.Allocator, boolean_names: []const []const u8) !@This() {
+        const booleans = try alloc.alloc(?usz, boolean_names.len);
+        for (booleans, boolean_names) |*world_index, name| world_index.* = state.getBooleanIndex(name);
+        return .{ .state = state, .booleans = booleans, .reader = try state.registerReader() };
+    }
+};
+
+/// resolves string variables for interpolation, preferring the world state's variables
+const StringVariables = struct {
+    ctx: *const DialogueContext,
+
+    pub fn get(self: @This(), name: []const u8) ?[]const u8 {
+        if (self.ctx.world) |world| if (world.state.getStringIndex(name)) |world_index|
+            return world.state.readString(world.reader, world_index) orelse "<UNSET>";
+        const variable = self.ctx.variables.strings.getPtr(name) orelse return null;
+        return variable.slice();
+    }
+};
+
+/// the variables read by condition expressions
+const ConditionVariables = struct {
+    ctx: *const DialogueContext,
+
+    pub fn getBoolean(self: @This(), var_index: usz) bool {
+        return self.ctx.readBoolean(var_index);
+    }
+
+    pub fn getString(self: @This(), name: []const u8) []const u8 {
+        return (StringVariables{ .ctx = self.ctx }).get(name) orelse "<UNSET>";
+    }
+};
+
+/// where the texts of a dialogue's nodes are in the context's TextStore
+const TextRefs = struct {
+    /// for each node, the index of its first ref: a line has the refs of its text and metadata,
+    /// and a reply those of each of its options in order
+    first: []const u32,
+    refs: []const TextStore.Ref,
+};
+
 const Dialogue = struct {
     name: []const u8,
     nodes: std.MultiArrayList(Node),
     // FIXME: optimize to fit in usize or even u32
     current_node_index: ?usz,
     label_to_node_ids: std.StringHashMapUnmanaged(usz),
+    /// the amount of random draws this dialogue made, the counter of its random stream
+    random_draws: u64 = 0,
+    /// if set, the texts and metadata of the nodes are empty, and are read from the text store
+    /// instead. Kept in the context's arena. @see DialogueContext.InitOpts.compress_text
+    text_refs: ?TextRefs = null,
 
     pub fn deinit(self: *@This(), alloc: std.mem.Allocator) void {
         alloc.free(self.name);
         self.nodes.deinit(alloc);
         self.label_to_node_ids.deinit(alloc);
     }
+
+    /// deinit, including what the nodes allocated
+    pub fn deinitNodes(self: *@This(), alloc: std.mem.Allocator) void {
+        freeNodeConditions(self.nodes, alloc);
+        self.deinit(alloc);
+    }
+};
+
+/// copies the strings which are kept from the json out of the parse arena, once per distinct string
+const Interner = struct {
+    alloc: std.mem.Allocator,
+    /// if null, strings are kept where they are, since the json was parsed into the context's arena
+    strings: ?std.StringHashMap(void),
+
+    fn intern(self: *@This(), str: []const u8) ![]const u8 {
+        const strings = if (self.strings) |*map| map else return str;
+        const entry = try strings.getOrPut(str);
+        if (!entry.found_existing) {
+            // aligned in case it is a utf16 speaker
+            const copy = try self.alloc.alignedAlloc(u8, 2, str.len);
+            @memcpy(copy, str);
+            entry.key_ptr.* = copy;
+        }
+        return entry.key_ptr.*;
+    }
+
+    fn deinit(self: *@This()) void {
+        if (self.strings) |*strings| strings.deinit();
+    }
+};
+
+/// move the texts and metadata of the dialogues' nodes into a compressed text store, and copy
+/// everything else that the nodes keep out of the parse arena. @see DialogueContext.InitOpts.compress_text
+fn compressTexts(
+    dialogues: []Dialogue,
+    alloc: std.mem.Allocator,
+    arena_alloc: std.mem.Allocator,
+    interner: *Interner,
+) !TextStore {
+    var builder = TextStore.Builder.init(alloc, TextStore.default_block_size);
+    defer builder.deinit();
+
+    var refs = std.ArrayListUnmanaged(TextStore.Ref){};
+    defer refs.deinit(alloc);
+
+    for (dialogues) |*dialogue| {
+        refs.clearRetainingCapacity();
+        const first = try arena_alloc.alloc(u32, dialogue.nodes.len);
+
+        for (first, 0..) |*first_ref, i| {
+            first_ref.* = @intCast(refs.items.len);
+            var node = dialogue.nodes.get(i);
+            switch (node) {
+                .line => |*v| v.data = try compressLine(v.data, &builder, &refs, alloc, interner),
+                .reply => |*v| {
+                    const texts = try arena_alloc.alloc(Line, v.texts.len);
+                    for (texts, v.texts.toZig()) |*text, json_text|
+                        text.* = try compressLine(json_text, &builder, &refs, alloc, interner);
+                    v.texts = Slice(Line).fromZig(texts);
+                    v.nexts = try arena_alloc.dupe(Next, v.nexts);
+                    // the programs are in the context's arena, but their strings are from the json
+                    for (v.conditions) |cond| if (cond == .expr) {
+                        const program: *condition_vm.Program = @constCast(cond.expr);
+                        const strings = try arena_alloc.alloc([]const u8, program.strings.len);
+                        for (strings, program.strings) |*str, json_str| str.* = try interner.intern(json_str);
+                        program.strings = strings;
+                    };
+                },
+                .random_switch => |*v| v.* = RandomSwitch.init(
+                    try arena_alloc.dupe(Next, v.nexts),
+                    try arena_alloc.dupe(u32, v.chances),
+                ),
+                inline .lock, .unlock => |*v| v.boolean_var_name = try interner.intern(v.boolean_var_name),
+                .call => |*v| v.function_name = try interner.intern(v.function_name),
+            }
+            dialogue.nodes.set(i, node);
+        }
+
+        dialogue.text_refs = .{ .first = first, .refs = try arena_alloc.dupe(TextStore.Ref, refs.items) };
+    }
+
+    return builder.finish(arena_alloc);
+}
+
+/// add the text and metadata of a line to the store, returning it without them
+fn compressLine(
+    line: Line,
+    builder: *TextStore.Builder,
+    refs: *std.ArrayListUnmanaged(TextStore.Ref),
+    alloc: std.mem.Allocator,
+    interner: *Interner,
+) !Line {
+    try refs.append(alloc, try builder.add(line.text.toZig()));
+    try refs.append(alloc, if (line.metadata.toZig()) |metadata| try builder.add(metadata) else TextStore.Ref.none);
+    // speakers repeat too often to be worth compressing, and are interned instead
+    return .{ .speaker = Slice(u8).fromZig(try interner.intern(line.speaker.toZig())), .text = .{} };
+}
+
+// FIXME: nodes should encapsulate their own freeing logic better
+fn freeNodeConditions(nodes: std.MultiArrayList(Node), alloc: std.mem.Allocator) void {
+    const nodes_slice = nodes.slice();
+    for (nodes_slice.items(.tags), nodes_slice.items(.data)) |tag, data| {
+        if (tag != .reply) continue;
+        alloc.free(data.reply.conditions);
+    }
+}
+
+/// converts and validates the dialogues of a file, each independently of the others,
+/// so that they can be compiled in parallel
+const DialogueCompiler = struct {
+    /// thread safe when compiling in parallel
+    alloc: std.mem.Allocator,
+    /// for the compiled expressions, kept in the context's arena.
+    /// When compiling in parallel, each chunk has an arena of its own instead, @see compileAllParallel
+    program_alloc: std.mem.Allocator,
+    /// for transcoded texts, the context's arena, or the parse arena if they will be compressed
+    text_alloc: std.mem.Allocator,
+    booleans: *const std.StringArrayHashMap(bool),
+    strings: *const std.StringArrayHashMap(StringVariable),
+    output_encoding: TextEncoding,
+    interpolated: bool,
+
+    /// below this, starting threads takes longer than compiling on one
+    const min_parallel_dialogues = 16;
+
+    /// details of an error, kept for the caller to format the diagnostic with its allocator
+    const Failure = union(enum) {
+        bad_condition: struct { node_index: usize, message: []const u8 },
+        bad_next: struct { node_index: usize, next: usize },
+        invalid_node: usize,
+    };
+
+    const Output = struct {
+        dialogue: Dialogue = undefined,
+        compiled: bool = false,
+        max_option_count: usize = 0,
+        err: ?DialogueContext.InitFromJsonError = null,
+        failure: ?Failure = null,
+    };
+
+    fn compile(self: *const @This(), name: []const u8, json_dialogue: DialogueBodyJson, output: *Output) void {
+        self.tryCompile(name, json_dialogue, output) catch |e| {
+            output.err = e;
+        };
+    }
+
+    fn tryCompile(self: *const @This(), name: []const u8, json_dialogue: DialogueBodyJson, output: *Output) DialogueContext.InitFromJsonError!void {
+        const alloc = self.alloc;
+
+        const dialogue_name = try alloc.dupe(u8, name);
+        errdefer alloc.free(dialogue_name);
+
+        var nodes = std.MultiArrayList(Node){};
+        errdefer {
+            freeNodeConditions(nodes, alloc);
+            nodes.deinit(alloc);
+        }
+        try nodes.ensureTotalCapacity(alloc, @intCast(json_dialogue.nodes.len));
+
+        var label_to_node_ids = std.StringHashMapUnmanaged(usz){};
+        errdefer label_to_node_ids.deinit(alloc);
+        try label_to_node_ids.ensureTotalCapacity(alloc, @intCast(json_dialogue.nodes.len));
+
+        for (json_dialogue.nodes, 0..) |json_node, i| {
+            var condition_diagnostic = condition_vm.CompileDiagnostic{};
+            const maybe_parsed_node = json_node.toNode(alloc, self.program_alloc, self.booleans, self.strings, &condition_diagnostic) catch |e| {
+                if (e == error.AlternisBadCondition)
+                    output.failure = .{ .bad_condition = .{ .node_index = i, .message = condition_diagnostic.message } };
+                return e;
+            };
+            const parsed_node = maybe_parsed_node orelse {
+                output.failure = .{ .invalid_node = i };
+                return error.AlternisInvalidNode;
+            };
+
+            // the nodes are already allocated, so once appended they are freed with them
+            nodes.appendAssumeCapacity(parsed_node);
+            // NOTE: transcoded texts are kept in the arena with the rest of the json strings
+            const node = try parsed_node.encodeTexts(self.text_alloc, self.output_encoding, self.interpolated);
+            nodes.set(nodes.len - 1, node);
+
+            // TODO: push out to verify nodes function
+            switch (node) {
+                inline .reply, .random_switch => |v| {
+                    for (v.nexts) |maybe_next| {
+                        if (maybe_next.toOptionalInt(usize)) |next| if (next >= json_dialogue.nodes.len) {
+                            output.failure = .{ .bad_next = .{ .node_index = i, .next = next } };
+                            return error.AlternisBadNextNode;
+                        };
+                    }
+
+                    switch (node) {
+                        .reply => |as_reply| {
+                            output.max_option_count = @max(as_reply.texts.len, output.max_option_count);
+                        },
+                        else => {},
+                    }
+                },
+                inline else => |n| if (n.next.toOptionalInt(usize)) |next|
+                    if (next >= json_dialogue.nodes.len) {
+                        output.failure = .{ .bad_next = .{ .node_index = i, .next = next } };
+                        return error.AlternisBadNextNode;
+                    },
+            }
+        }
+
+        output.dialogue = .{
+            .name = dialogue_name,
+            .nodes = nodes,
+            .current_node_index = 0,
+            .label_to_node_ids = label_to_node_ids,
+        };
+        output.compiled = true;
+    }
+
+    fn compileAll(
+        self: *const @This(),
+        names: []const []const u8,
+        json_dialogues: []const DialogueBodyJson,
+        outputs: []Output,
+    ) void {
+        for (names, json_dialogues, outputs) |name, json_dialogue, *output|
+            self.compile(name, json_dialogue, output);
+    }
+
+    /// the dialogues compiled by one task, with arenas of its own so that only the nodes,
+    /// which are allocated from the user's allocator, take a lock
+    const Chunk = struct {
+        compiler: DialogueCompiler,
+        program_arena: std.heap.ArenaAllocator,
+        /// unused if texts are kept with the programs
+        text_arena: std.heap.ArenaAllocator,
+        names: []const []const u8,
+        json_dialogues: []const DialogueBodyJson,
+        outputs: []Output,
+
+        fn compile(chunk: *@This(), wait_group: *std.Thread.WaitGroup) void {
+            defer wait_group.finish();
+            chunk.compiler.compileAll(chunk.names, chunk.json_dialogues, chunk.outputs);
+        }
+    };
+
+    /// compile chunks of the dialogues on a thread pool, falling back to the calling thread
+    /// for any that couldn't be spawned. Each chunk allocates programs and texts from its own
+    /// arenas, which are moved into `program_arena` and `text_arena` once every chunk is done.
+    /// `text_arena` may be `program_arena`
+    fn compileAllParallel(
+        self: *const @This(),
+        names: []const []const u8,
+        json_dialogues: []const DialogueBodyJson,
+        outputs: []Output,
+        thread_count: ?u32,
+        program_arena: *std.heap.ArenaAllocator,
+        text_arena: *std.heap.ArenaAllocator,
+    ) void {
+        var pool: std.Thread.Pool = undefined;
+        pool.init(.{ .allocator = self.alloc, .n_jobs = thread_count }) catch
+            return self.compileAll(names, json_dialogues, outputs);
+        defer pool.deinit();
+
+        const target_tasks = @max(pool.threads.len, 1) * 4;
+        const chunk_len = @max(1, std.math.divCeil(usize, names.len, target_tasks) catch unreachable);
+        const chunks = self.alloc.alloc(Chunk, std.math.divCeil(usize, names.len, chunk_len) catch unreachable) catch
+            return self.compileAll(names, json_dialogues, outputs);
+        defer self.alloc.free(chunks);
+
+        for (chunks, 0..) |*chunk, i| {
+            const chunk_start = i * chunk_len;
+            const chunk_end = @min(chunk_start + chunk_len, names.len);
+            chunk.* = .{
+                .compiler = self.*,
+                .program_arena = std.heap.ArenaAllocator.init(self.alloc),
+                .text_arena = std.heap.ArenaAllocator.init(self.alloc),
+                .names = names[chunk_start..chunk_end],
+                .json_dialogues = json_dialogues[chunk_start..chunk_end],
+                .outputs = outputs[chunk_start..chunk_end],
+            };
+            // the chunks don't move anymore, so their arenas can be pointed to
+            chunk.compiler.program_alloc = chunk.program_arena.allocator();
+            chunk.compiler.text_alloc = if (text_arena == program_arena)
+                chunk.compiler.program_alloc
+            else
+                chunk.text_arena.allocator();
+        }
+
+        var wait_group = std.Thread.WaitGroup{};
+        for (chunks) |*chunk| {
+            wait_group.start();
+            pool.spawn(Chunk.compile, .{ chunk, &wait_group }) catch chunk.compile(&wait_group);
+        }
+        pool.waitAndWork(&wait_group);
+
+        for (chunks) |*chunk| {
+            adoptArena(program_arena, &chunk.program_arena);
+            adoptArena(text_arena, &chunk.text_arena);
+        }
+    }
 };
 
+/// move the buffers of `from` into `into`, so that what was allocated from `from` is freed with `into`.
+/// The arenas' child allocators must free each other's buffers, e.g. a thread safe wrapper and the allocator it wraps
+fn adoptArena(into: *std.heap.ArenaAllocator, from: *std.heap.ArenaAllocator) void {
+    defer from.state = .{};
+    const first = into.state.buffer_list.first orelse {
+        into.state = from.state;
+        return;
+    };
+    // behind the first buffer, which `into` keeps allocating from
+    while (from.state.buffer_list.popFirst()) |node| first.insertAfter(node);
+}
+
 pub const DialogueContext = struct {
     // FIXME: deep copy the relevant results, this keeps unused json strings
     arena: std.heap.ArenaAllocator,
@@ -181,25 +610,53 @@ pub const DialogueContext = struct {
 
     functions: std.StringHashMap(?Callback),
     variables: struct {
-        strings: std.StringHashMap([]const u8),
+        strings: std.StringArrayHashMap(StringVariable),
         // FIXME: use custom dynamic bit set like structure for this
         // maybe just a String->index hash map + dynamic bit set
-        booleans: std.StringHashMap(bool),
+        /// array backed so that nodes can refer to a variable by its stable index
+        booleans: std.StringArrayHashMap(bool),
     },
 
-    /// the pseudo-random number generator for the RandomSwitch
-    rand: std.rand.DefaultPrng,
+    /// the latest changes to the variables, and which changed since the host last asked
+    changes: ChangeLog,
+
+    /// the seed of the random streams of the dialogues for the RandomSwitch, @see counter_rng.zig
+    random_seed: u64,
 
     do_interpolate: bool,
 
+    /// the encoding of the strings in step results
+    output_encoding: TextEncoding = .utf8,
+
     /// buffer for storing the texts of the dynamic list of a StepResult .options variant
     step_options_buffer: MutSlice(Line),
     /// buffer for storing the ids of the dynamic list of a StepResult .options variant
     step_option_ids_buffer: MutSlice(usize),
 
-    /// step() stores a copy of its result here, so that its contents can be freed between steps
-    /// when using string variable interpolation
-    step_result_buffer: ?StepResult = null,
+    /// interpolated texts of step results, reset at the start of each step, advance and peek,
+    /// so that memory stays constant however often variables change
+    scratch: std.heap.ArenaAllocator,
+
+    /// variables which are declared by the dialogue and the world state are read from and
+    /// written to the world state instead of this context. @see InitOpts.world_state
+    world: ?WorldBinding = null,
+    /// the last world string read by getVariableString
+    world_string_copy: std.ArrayListUnmanaged(u8) = .{},
+
+    /// if set, records everything needed to replay this context. @see InitOpts.trace
+    trace: ?*trace.Recorder = null,
+
+    /// if set, stepping pushes events here instead of calling callbacks. @see InitOpts.events
+    events: ?*EventRing = null,
+
+    /// if set, the compiled dialogues (nodes, names, labels) are borrowed from this context,
+    /// which must outlive this one. @see initShared
+    source: ?*const DialogueContext = null,
+
+    /// the compressed texts of the dialogues, empty unless InitOpts.compress_text. Borrowed from the source if shared
+    text_store: TextStore = .{},
+    /// the blocks of the text store which were read last
+    text_cache: TextStore.Cache,
 
     pub const StepResult = extern struct {
         /// tag indicates which field is active
@@ -222,17 +679,6 @@ pub const DialogueContext = struct {
             line: Line,
             function_called: void,
         } = undefined,
-
-        pub fn free(self: *@This(), alloc: std.mem.Allocator) void {
-            switch (self.tag) {
-                .line => self.data.line.free(alloc),
-                .options => {
-                    alloc.free(self.data.options.ids.toZig());
-                    for (self.data.options.texts.toZig()) |*l| l.free(alloc);
-                },
-                else => {},
-            }
-        }
     };
 
     pub const InitOpts = struct {
@@ -240,6 +686,39 @@ pub const DialogueContext = struct {
         random_seed: ?u64 = null,
         /// do not interpolate text variables in texts when stepping through the dialogue
         no_interpolate: bool = false,
+        /// the encoding of the strings in step results, static texts are transcoded once during init.
+        /// ignored by initShared, which uses the encoding of the source
+        output_encoding: TextEncoding = .utf8,
+        /// allocator for diagnostic messages, defaults to the context's allocator.
+        /// useful if the context's allocator is torn down when init fails
+        diagnostic_alloc: ?std.mem.Allocator = null,
+        /// variables shared with other contexts, which must outlive this one. Any of the dialogue's
+        /// variables with the same name and type as a world state variable is bound to it, so that
+        /// setting it once (in the world state, or in any bound context) is seen by every context.
+        /// Contexts on different threads may step while the world state is written
+        world_state: ?*WorldState = null,
+        /// record a trace of the context, which must outlive it. The header is written during init,
+        /// the caller must flush the recorder when done. @see trace.zig
+        trace: ?*trace.Recorder = null,
+        /// push the lines, calls and lock/unlock changes of stepping to this ring, which must
+        /// outlive the context, so a host on another thread can drain them. Call nodes then
+        /// don't call their callbacks, but steps still return function_called. @see EventRing.zig
+        events: ?*EventRing = null,
+        /// the amount of latest variable changes kept for changesSince, 0 to only track dirty flags
+        change_log_capacity: usize = 32,
+        /// keep the texts and metadata of lines and replies in compressed blocks, which are
+        /// decompressed when stepping reaches them, for large dialogue files on memory constrained
+        /// targets. The json is then parsed into a temporary arena, so that only what the context
+        /// keeps stays resident. Costs a decompression whenever a block isn't cached, and lines
+        /// pushed to the event ring have no text or metadata, since those live only in reused memory.
+        /// Ignored by initShared, which uses the texts of the source
+        compress_text: bool = false,
+        /// the amount of decompressed blocks of about TextStore.default_block_size kept per context
+        text_cache_blocks: usize = 4,
+        /// threads to compile the dialogues of the file on, where null is one per core once there are
+        /// enough dialogues for it to pay off, and 1 compiles on the calling thread.
+        /// The allocator is only used from one thread at a time. Ignored in single threaded builds
+        compile_thread_count: ?u32 = null,
         // /// a plugin to transform text. e.g. add/strip html/bbcode, etc, for any environment
         // textPlugin: TextPlugin? = null,
     };
@@ -277,6 +756,7 @@ pub const DialogueContext = struct {
         AlternisBadNextNode,
         AlternisInvalidNode,
         AlternisDefaultSeedUnsupportedPlatform,
+        AlternisBadCondition,
     };
 
     pub const InitFromJsonError = AlternisError || json.ParseError(json.Scanner) || std.mem.Allocator.Error;
@@ -288,121 +768,174 @@ pub const DialogueContext = struct {
         diagnostic: *Diagnostic,
     ) InitFromJsonError!DialogueContext {
         diagnostic.* = Diagnostic.new("No context. See error code");
+        const diagnostic_alloc = opts.diagnostic_alloc orelse alloc;
 
         // FIXME: use a separate arena for json parsing, deinit it that one,
         // and deep clone out all needed strings into this one (@see toNodeAlloc)
         var arena = std.heap.ArenaAllocator.init(alloc);
+        errdefer arena.deinit();
         const arena_alloc = arena.allocator();
 
         // FIXME: cloning only the necessary strings will lower memory footprint,
+        // for now only done with compressed texts, where the raw texts would defeat the point
+        var parse_arena = std.heap.ArenaAllocator.init(alloc);
+        defer parse_arena.deinit();
+        const json_alloc = if (opts.compress_text) parse_arena.allocator() else arena_alloc;
+
+        var interner = Interner{
+            .alloc = arena_alloc,
+            .strings = if (opts.compress_text) std.StringHashMap(void).init(alloc) else null,
+        };
+        defer interner.deinit();
 
         var json_diagnostics = json.Diagnostics{};
-        var json_scanner = json.Scanner.initCompleteInput(arena_alloc, json_text);
+        var json_scanner = json.Scanner.initCompleteInput(json_alloc, json_text);
         json_scanner.enableDiagnostics(&json_diagnostics);
 
-        const data = json.parseFromTokenSourceLeaky(DialogueJson, arena_alloc, &json_scanner, .{
+        const data = json.parseFromTokenSourceLeaky(DialogueJson, json_alloc, &json_scanner, .{
             .ignore_unknown_fields = true,
             .allocate = .alloc_always,
         }) catch |e| {
-            diagnostic.* = try Diagnostic.format(alloc, "{}: {}", .{ e, json_diagnostics });
+            diagnostic.* = try Diagnostic.format(diagnostic_alloc, "{}: {}", .{ e, json_diagnostics });
             return e;
         };
 
         if (data.version != 1) {
-            diagnostic.* = try Diagnostic.format(alloc, "unknown file version '{}'. This engine supports only version '1'", .{data.version});
+            diagnostic.* = try Diagnostic.format(diagnostic_alloc, "unknown file version '{}'. This engine supports only version '1'", .{data.version});
             return error.AlternisUnknownVersion;
         }
 
-        var booleans = std.StringHashMap(bool).init(alloc);
+        var booleans = std.StringArrayHashMap(bool).init(alloc);
+        errdefer booleans.deinit();
         try booleans.ensureTotalCapacity(@intCast(data.variables.boolean.len));
 
         // FIXME: this is super broken methinks, both StringHashMap says key memory is owned by caller, which means gets will never work since
         // they don't have access to the mmaped JSON
         for (data.variables.boolean) |json_var|
-            try booleans.put(json_var.name, false);
+            try booleans.put(try interner.intern(json_var.name), false);
 
-        var strings = std.StringHashMap([]const u8).init(alloc);
+        var strings = std.StringArrayHashMap(StringVariable).init(alloc);
+        errdefer strings.deinit();
         try strings.ensureTotalCapacity(@intCast(data.variables.string.len));
         for (data.variables.string) |json_var| {
-            try strings.put(json_var.name, "<UNSET>");
+            try strings.put(try interner.intern(json_var.name), StringVariable.unset);
         }
 
         var functions = std.StringHashMap(?Callback).init(alloc);
+        errdefer functions.deinit();
         try functions.ensureTotalCapacity(@intCast(data.functions.len));
         for (data.functions) |json_func|
-            try functions.put(json_func.name, null);
-
-        var max_option_count: usize = 0;
+            try functions.put(try interner.intern(json_func.name), null);
 
-        var dialogues = try arena_alloc.alloc(Dialogue, data.dialogues.map.count());
+        const dialogues = try arena_alloc.alloc(Dialogue, data.dialogues.map.count());
 
-        const string_pool = StringPool{};
+        const compile_outputs = try alloc.alloc(DialogueCompiler.Output, dialogues.len);
+        defer alloc.free(compile_outputs);
+        for (compile_outputs) |*output| output.* = .{};
+        errdefer for (compile_outputs) |*output| if (output.compiled) output.dialogue.deinitNodes(alloc);
 
         {
-            var dialogue_iter = data.dialogues.map.iterator();
-            var dialogue_index: usize = 0;
-            while (dialogue_iter.next()) |dialogue_entry| : (dialogue_index += 1) {
-                const dialogue_name = try alloc.dupe(u8, dialogue_entry.key_ptr.*);
-
-                const json_dialogue = dialogue_entry.value_ptr.*;
-                const out_dialogue = &dialogues[dialogue_index];
-
-                var nodes = std.MultiArrayList(Node){};
-                try nodes.ensureTotalCapacity(alloc, @intCast(json_dialogue.nodes.len));
-
-                var label_to_node_ids = std.StringHashMapUnmanaged(usz){};
-                try label_to_node_ids.ensureTotalCapacity(alloc, @intCast(json_dialogue.nodes.len));
-
-                for (json_dialogue.nodes, 0..) |json_node, i| {
-                    if (json_node.toNode(alloc, &booleans)) |node| {
-                        try nodes.append(alloc, node);
-
-                        // TODO: push out to verify nodes function
-                        switch (node) {
-                            inline .reply, .random_switch => |v| {
-                                for (v.nexts) |maybe_next| {
-                                    if (maybe_next.toOptionalInt(usize)) |next| if (next >= json_dialogue.nodes.len) {
-                                        diagnostic.* = try Diagnostic.format(alloc, "bad next node '{}' on node '{}'", .{ next, i });
-                                        return error.AlternisBadNextNode;
-                                    };
-                                }
-
-                                switch (node) {
-                                    .reply => |as_reply| {
-                                        max_option_count = @max(as_reply.texts.len, max_option_count);
-                                    },
-                                    else => {},
-                                }
-                            },
-                            inline else => |n| if (n.next.toOptionalInt(usize)) |next|
-                                if (next >= json_dialogue.nodes.len) {
-                                    diagnostic.* = try Diagnostic.format(alloc, "bad next node '{}' on node '{}'", .{ next, i });
-                                    return error.AlternisBadNextNode;
-                                },
-                        }
-                    } else {
-                        diagnostic.* = try Diagnostic.format(alloc, "invalid node (index={}) without type or data", .{i});
-                        return error.AlternisInvalidNode;
-                    }
-                }
+            // the dialogues are independent, so they can be compiled in parallel with
+            // a thread safe user allocator and arenas per chunk, against the already built variable indices
+            const parallel = !builtin.single_threaded and (if (opts.compile_thread_count) |thread_count|
+                thread_count != 1
+            else
+                dialogues.len >= DialogueCompiler.min_parallel_dialogues);
+
+            var thread_safe_alloc = std.heap.ThreadSafeAllocator{ .child_allocator = alloc };
+
+            const compiler = DialogueCompiler{
+                .alloc = if (parallel) thread_safe_alloc.allocator() else alloc,
+                .program_alloc = arena_alloc,
+                .text_alloc = if (opts.compress_text) parse_arena.allocator() else arena_alloc,
+                .booleans = &booleans,
+                .strings = &strings,
+                .output_encoding = opts.output_encoding,
+                .interpolated = !opts.no_interpolate,
+            };
 
-                out_dialogue.* = .{
-                    .name = dialogue_name,
-                    .nodes = nodes,
-                    .current_node_index = 0,
-                    .label_to_node_ids = label_to_node_ids,
-                };
+            if (parallel) {
+                compiler.compileAllParallel(
+                    data.dialogues.map.keys(),
+                    data.dialogues.map.values(),
+                    compile_outputs,
+                    opts.compile_thread_count,
+                    &arena,
+                    if (opts.compress_text) &parse_arena else &arena,
+                );
+            } else {
+                compiler.compileAll(data.dialogues.map.keys(), data.dialogues.map.values(), compile_outputs);
             }
         }
 
-        errdefer {
-            for (dialogues) |*d| d.deinit(alloc);
+        var max_option_count: usize = 0;
+
+        // report the failure of the first failed dialogue, so that it doesn't depend on scheduling
+        for (compile_outputs, dialogues) |output, *dialogue| {
+            if (output.err) |e| {
+                if (output.failure) |failure| diagnostic.* = try switch (failure) {
+                    .bad_condition => |v| Diagnostic.format(diagnostic_alloc, "bad condition on node '{}': {s}", .{ v.node_index, v.message }),
+                    .bad_next => |v| Diagnostic.format(diagnostic_alloc, "bad next node '{}' on node '{}'", .{ v.next, v.node_index }),
+                    .invalid_node => |node_index| Diagnostic.format(diagnostic_alloc, "invalid node (index={}) without type or data", .{node_index}),
+                };
+                return e;
+            }
+            dialogue.* = output.dialogue;
+            max_option_count = @max(output.max_option_count, max_option_count);
         }
 
         const step_options_buffer = MutSlice(Line).fromZig(alloc.alloc(Line, max_option_count) catch unreachable);
+        errdefer alloc.free(step_options_buffer.toZig());
         const step_option_ids_buffer = MutSlice(usize).fromZig(alloc.alloc(usize, max_option_count) catch unreachable);
+        errdefer alloc.free(step_option_ids_buffer.toZig());
+
+        const text_store = if (opts.compress_text)
+            try compressTexts(dialogues, alloc, arena_alloc, &interner)
+        else
+            TextStore{};
+
+        const seed = try resolveSeed(opts, diagnostic_alloc, diagnostic);
+
+        var changes = try ChangeLog.init(alloc, opts.change_log_capacity, booleans.count(), strings.count());
+        errdefer changes.deinit(alloc);
+
+        var text_cache = try TextStore.Cache.init(alloc, if (opts.compress_text) @max(opts.text_cache_blocks, 1) else 0);
+        errdefer text_cache.deinit(alloc);
+
+        const world = if (opts.world_state) |world_state|
+            try WorldBinding.init(world_state, arena_alloc, booleans.keys())
+        else
+            null;
+
+        if (opts.trace) |recorder| recorder.begin(seed);
+
+        return DialogueContext{
+            // FIXME:
+            .string_pool = .{},
+            .dialogues = dialogues,
+            .functions = functions,
+            .variables = .{
+                .strings = strings,
+                .booleans = booleans,
+            },
+            .changes = changes,
+            .random_seed = seed,
+            .arena = arena,
+            .scratch = std.heap.ArenaAllocator.init(alloc),
+            .step_options_buffer = step_options_buffer,
+            .step_option_ids_buffer = step_option_ids_buffer,
+            .do_interpolate = !opts.no_interpolate,
+            .output_encoding = opts.output_encoding,
+            .world = world,
+            .trace = opts.trace,
+            .events = opts.events,
+            .text_store = text_store,
+            .text_cache = text_cache,
+        };
+    }
 
-        const seed = opts.random_seed orelse _: {
+    fn resolveSeed(opts: InitOpts, alloc: std.mem.Allocator, diagnostic: *Diagnostic) InitFromJsonError!u64 {
+        return opts.random_seed orelse _: {
             if (builtin.os.tag == .freestanding) {
                 diagnostic.* = try Diagnostic.format(alloc, "automatic seed not supported on wasm platform", .{});
                 return error.AlternisDefaultSeedUnsupportedPlatform;
@@ -412,44 +945,115 @@ pub const DialogueContext = struct {
             const time_seed: u64 = @bitCast(time);
             break :_ time_seed;
         };
+    }
+
+    /// Create a context which reuses the already compiled dialogues of another context
+    /// instead of parsing the json again, e.g. for many instances of the same dialogue file.
+    /// The new context has its own variables, callbacks, random generator and positions, all
+    /// in their initial state. The source context must outlive the returned context.
+    /// Since the shared data is never mutated, any number of contexts may be created from one
+    /// source concurrently, as long as the source itself isn't being deinitialized
+    pub fn initShared(
+        source: *const DialogueContext,
+        alloc: std.mem.Allocator,
+        opts: InitOpts,
+        diagnostic: *Diagnostic,
+    ) InitFromJsonError!DialogueContext {
+        diagnostic.* = Diagnostic.new("No context. See error code");
+
+        var arena = std.heap.ArenaAllocator.init(alloc);
+        errdefer arena.deinit();
+
+        const dialogues = try arena.allocator().alloc(Dialogue, source.dialogues.len);
+        for (dialogues, source.dialogues) |*dialogue, source_dialogue| {
+            dialogue.* = source_dialogue;
+            dialogue.current_node_index = 0;
+            dialogue.random_draws = 0;
+        }
+
+        // NOTE: keys are owned by the source
+        var functions = try source.functions.cloneWithAllocator(alloc);
+        errdefer functions.deinit();
+        {
+            var callback_iter = functions.valueIterator();
+            while (callback_iter.next()) |callback| callback.* = null;
+        }
+
+        var booleans = try source.variables.booleans.cloneWithAllocator(alloc);
+        errdefer booleans.deinit();
+        for (booleans.values()) |*value| value.* = false;
+
+        var strings = try source.variables.strings.cloneWithAllocator(alloc);
+        errdefer strings.deinit();
+        // the source's buffers are its own
+        for (strings.values()) |*value| value.* = StringVariable.unset;
+
+        const step_options_buffer = try alloc.alloc(Line, source.step_options_buffer.len);
+        errdefer alloc.free(step_options_buffer);
+        const step_option_ids_buffer = try alloc.alloc(usize, source.step_option_ids_buffer.len);
+        errdefer alloc.free(step_option_ids_buffer);
+
+        const seed = try resolveSeed(opts, opts.diagnostic_alloc orelse alloc, diagnostic);
+
+        var changes = try ChangeLog.init(alloc, opts.change_log_capacity, booleans.count(), strings.count());
+        errdefer changes.deinit(alloc);
+
+        const compressed = source.dialogues.len > 0 and source.dialogues[0].text_refs != null;
+        var text_cache = try TextStore.Cache.init(alloc, if (compressed) @max(opts.text_cache_blocks, 1) else 0);
+        errdefer text_cache.deinit(alloc);
+
+        const world = if (opts.world_state) |world_state|
+            try WorldBinding.init(world_state, arena.allocator(), booleans.keys())
+        else
+            null;
+
+        if (opts.trace) |recorder| recorder.begin(seed);
 
         return DialogueContext{
-            // FIXME:
-            .string_pool = string_pool,
+            .string_pool = .{},
             .dialogues = dialogues,
             .functions = functions,
             .variables = .{
                 .strings = strings,
                 .booleans = booleans,
             },
-            .rand = std.rand.DefaultPrng.init(seed),
+            .changes = changes,
+            .random_seed = seed,
             .arena = arena,
-            .step_options_buffer = step_options_buffer,
-            .step_option_ids_buffer = step_option_ids_buffer,
-            .do_interpolate = !opts.no_interpolate,
+            .scratch = std.heap.ArenaAllocator.init(alloc),
+            .step_options_buffer = MutSlice(Line).fromZig(step_options_buffer),
+            .step_option_ids_buffer = MutSlice(usize).fromZig(step_option_ids_buffer),
+            // transcoded texts were prepared for whether the source interpolates, so it must match
+            .do_interpolate = if (source.output_encoding == .utf8) !opts.no_interpolate else source.do_interpolate,
+            // the shared texts are already transcoded
+            .output_encoding = source.output_encoding,
+            .world = world,
+            .trace = opts.trace,
+            .events = opts.events,
+            .source = source,
+            // the blocks are in the source's arena
+            .text_store = source.text_store,
+            .text_cache = text_cache,
         };
     }
 
     pub fn deinit(self: *@This(), alloc: std.mem.Allocator) void {
-        for (self.dialogues) |*dialogue| {
-            // FIXME: nodes should encapsulate their own freeing logic better
-            {
-                const nodes_slice = dialogue.nodes.slice();
-                for (nodes_slice.items(.tags), nodes_slice.items(.data)) |tag, data| {
-                    if (tag != .reply) continue;
-                    alloc.free(data.reply.conditions);
-                }
-            }
-
-            // no need to free self.step_result_buffer, it uses the arena
-            dialogue.deinit(alloc);
+        // the nodes are borrowed from the source context
+        if (self.source == null) {
+            for (self.dialogues) |*dialogue| dialogue.deinitNodes(alloc);
         }
         alloc.free(self.step_options_buffer.toZig());
         alloc.free(self.step_option_ids_buffer.toZig());
-        // NOTE: keys and string values are in the arena
+        // NOTE: keys are in the arena
         self.functions.deinit();
         self.variables.booleans.deinit();
+        for (self.variables.strings.values()) |*value| value.deinit(alloc);
         self.variables.strings.deinit();
+        self.changes.deinit(alloc);
+        self.text_cache.deinit(alloc);
+        self.world_string_copy.deinit(alloc);
+        if (self.world) |world| world.state.unregisterReader(world.reader);
+        self.scratch.deinit();
         self.arena.deinit();
     }
 
@@ -461,12 +1065,80 @@ pub const DialogueContext = struct {
             null;
     }
 
+    /// resident bytes of a context by category
+    pub const MemoryReport = extern struct {
+        /// compiled nodes and their reply conditions, 0 for a context sharing another's nodes
+        nodes: usize = 0,
+        /// the arena with the dialogue file's strings and texts (compressed if InitOpts.compress_text),
+        /// along with other small static data
+        text: usize = 0,
+        /// buffers of string variable values which don't fit inline
+        variables: usize = 0,
+        /// hash maps of variables, functions and labels, approximately
+        maps: usize = 0,
+        /// step result buffers, interpolated texts and decompressed text blocks
+        scratch: usize = 0,
+    };
+
+    pub fn memoryReport(self: *const @This()) MemoryReport {
+        var report = MemoryReport{
+            .text = self.arena.queryCapacity(),
+            .scratch = self.scratch.queryCapacity() +
+                self.step_options_buffer.len * @sizeOf(Line) +
+                self.step_option_ids_buffer.len * @sizeOf(usize) +
+                self.text_cache.residentBytes(),
+            .maps = hashMapBytes([]const u8, ?Callback, self.functions.capacity()) +
+                hashMapBytes([]const u8, bool, self.variables.booleans.capacity()) +
+                hashMapBytes([]const u8, StringVariable, self.variables.strings.capacity()),
+        };
+
+        if (self.source == null) for (self.dialogues) |dialogue| {
+            report.nodes += std.MultiArrayList(Node).capacityInBytes(dialogue.nodes.capacity);
+            for (0..dialogue.nodes.len) |i| switch (dialogue.nodes.get(i)) {
+                .reply => |v| report.nodes += v.conditions.len * @sizeOf(ConditionType),
+                else => {},
+            };
+            report.maps += hashMapBytes([]const u8, usz, dialogue.label_to_node_ids.capacity());
+        };
+
+        for (self.variables.strings.values()) |value| report.variables += value.residentBytes();
+        report.variables += self.changes.residentBytes();
+        report.variables += self.world_string_copy.capacity;
+
+        return report;
+    }
+
+    /// approximate bytes of a hash map's storage: a key, value and metadata byte per slot
+    fn hashMapBytes(comptime K: type, comptime V: type, capacity: usize) usize {
+        return capacity * (@sizeOf(K) + @sizeOf(V) + 1);
+    }
+
     pub fn getNodeByLabel(self: *@This(), dialogue_id: usz, label: []const u8) ?usz {
         return self.dialogues[dialogue_id].label_to_node_ids.get(label);
     }
 
+    /// the amount of random draws a dialogue has made. Along with the seed, this is all it takes to
+    /// reproduce the dialogue's next draws, e.g. to save and restore it. Resetting doesn't change it
+    pub fn randomDraws(self: *const @This(), dialogue_id: usz) u64 {
+        return self.dialogues[dialogue_id].random_draws;
+    }
+
+    /// continue a dialogue's random draws from a count returned by randomDraws, recorded to the trace as an input
+    pub fn setRandomDraws(self: *@This(), dialogue_id: usz, draws: u64) void {
+        if (self.trace) |recorder| recorder.record(.{ .set_random_draws = .{ .dialogue_id = dialogue_id, .draws = draws } });
+        self.dialogues[dialogue_id].random_draws = draws;
+    }
+
+    /// each dialogue draws from its own stream, so its draws don't depend on other dialogues
+    fn drawRandom(self: *@This(), dialogue_id: usz) f32 {
+        const dialogue = &self.dialogues[dialogue_id];
+        defer dialogue.random_draws += 1;
+        return counter_rng.float(self.random_seed, dialogue_id, dialogue.random_draws);
+    }
+
     /// the entry node of a dialogue is always 0
     pub fn reset(self: *@This(), dialogue_id: usz, node_index: usz) void {
+        if (self.trace) |recorder| recorder.record(.{ .reset = .{ .dialogue_id = dialogue_id, .node_index = node_index } });
         self.dialogues[dialogue_id].current_node_index = node_index;
     }
 
@@ -511,38 +1183,108 @@ pub const DialogueContext = struct {
         }
     }
 
-    pub fn setVariableBoolean(self: *@This(), name: []const u8, value: bool) void {
+    fn readBoolean(self: *const @This(), var_index: usize) bool {
+        if (self.world) |world| if (world.booleans[var_index]) |world_index|
+            return world.state.getBoolean(world_index);
+        return self.variables.booleans.values()[var_index];
+    }
+
+    fn writeBoolean(self: *@This(), var_index: usize, value: bool) void {
+        self.changes.recordBoolean(@intCast(var_index), self.readBoolean(var_index), value);
+        if (self.world) |world| if (world.booleans[var_index]) |world_index|
+            return world.state.setBoolean(world_index, value);
+        self.variables.booleans.values()[var_index] = value;
+    }
+
+    fn booleanIndex(self: *const @This(), name: []const u8) usize {
         // FIXME: don't panic
-        const var_ptr = self.variables.booleans.getPtr(name) orelse std.debug.panic("no such boolean variable: '{s}'", .{name});
+        return self.variables.booleans.getIndex(name) orelse std.debug.panic("no such boolean variable: '{s}'", .{name});
+    }
 
-        var_ptr.* = value;
+    /// if the variable is bound to the world state, sets it there
+    pub fn setVariableBoolean(self: *@This(), name: []const u8, value: bool) void {
+        const var_index = self.booleanIndex(name);
+        if (self.trace) |recorder| recorder.record(.{ .set_boolean = .{ .var_index = @intCast(var_index), .value = value } });
+        self.writeBoolean(var_index, value);
     }
 
     pub fn getVariableBoolean(self: *@This(), name: []const u8) bool {
-        return self.variables.booleans.get(name) orelse std.debug.panic("no such boolean variable: '{s}'", .{name});
+        return self.readBoolean(self.booleanIndex(name));
     }
 
     // FIXME: use a string-intern table and have id-based apis
     // FIXME: why not let the consumer own the memory?
-    /// the passed in "value" is always copied
+    /// the passed in "value" is always copied.
+    /// if the variable is bound to the world state, sets it there
     pub fn setVariableString(self: *@This(), name: []const u8, value: []const u8) void {
-        // will be cleaned up when area is deinited
-        const duped = self.arena.allocator().dupe(u8, value) catch |e| std.debug.panic("{}", .{e});
+        if (self.trace) |recorder| recorder.record(.{ .set_string = .{ .name = name, .value = value } });
 
         // FIXME: don't panic
-        const var_ptr = self.variables.strings.getPtr(name) orelse std.debug.panic("no such string variable: '{s}'", .{name});
+        const var_index = self.variables.strings.getIndex(name) orelse std.debug.panic("no such string variable: '{s}'", .{name});
 
-        var_ptr.* = duped;
+        if (self.world) |world| if (world.state.getStringIndex(name)) |world_index| {
+            {
+                // the old value may be reclaimed once the new one is written
+                world.state.beginRead(world.reader);
+                defer world.state.endRead(world.reader);
+                const old = world.state.readString(world.reader, world_index) orelse "<UNSET>";
+                self.changes.recordString(self.arena.child_allocator, @intCast(var_index), old, value) catch |e| std.debug.panic("{}", .{e});
+            }
+            return world.state.setString(world_index, value) catch |e| std.debug.panic("{}", .{e});
+        };
+
+        const var_ptr = &self.variables.strings.values()[var_index];
+        self.changes.recordString(self.arena.child_allocator, @intCast(var_index), var_ptr.slice(), value) catch |e| std.debug.panic("{}", .{e});
+
+        // the variable's storage is reused, so setting it often doesn't grow memory
+        var_ptr.set(self.arena.child_allocator, value) catch |e| std.debug.panic("{}", .{e});
     }
 
+    /// NOTE: the value is only valid until the variable is next set.
+    /// A variable bound to the world state may be replaced by another thread at any time, so its
+    /// value is copied into a buffer of the context, valid until the next getVariableString
     pub fn getVariableString(self: *@This(), name: []const u8) ?[]const u8 {
-        return self.variables.strings.get(name) orelse std.debug.panic("no such string variable: '{s}'", .{name});
+        if (!self.variables.strings.contains(name)) std.debug.panic("no such string variable: '{s}'", .{name});
+        const world = self.world orelse return (StringVariables{ .ctx = self }).get(name);
+        world.state.beginRead(world.reader);
+        defer world.state.endRead(world.reader);
+        const value = (StringVariables{ .ctx = self }).get(name).?;
+        if (world.state.getStringIndex(name) == null) return value;
+        self.world_string_copy.clearRetainingCapacity();
+        self.world_string_copy.appendSlice(self.arena.child_allocator, value) catch |e| std.debug.panic("{}", .{e});
+        return self.world_string_copy.items;
+    }
+
+    /// the sequence number of the latest change to a variable, 0 before any change
+    pub fn latestChangeSeq(self: *const @This()) u64 {
+        return self.changes.seq;
+    }
+
+    /// write the variable changes after the sequence number `seq` into `out`, oldest first.
+    /// Their string values are only valid until the next change. @see ChangeLog.changesSince
+    pub fn changesSince(self: *const @This(), seq: u64, out: []ChangeLog.Change) ChangeLog.ChangesSince {
+        return self.changes.changesSince(seq, out);
+    }
+
+    /// write the indices of variables of a type which changed since last taken, @see ChangeLog.takeDirty
+    pub fn takeDirtyVariables(self: *@This(), var_type: ChangeLog.VariableType, out: []usz) usize {
+        return self.changes.takeDirty(var_type, out);
+    }
+
+    /// the name of a variable by its index among the variables of its type, as in a ChangeLog.Change
+    pub fn variableName(self: *const @This(), var_type: ChangeLog.VariableType, index: usz) ?[]const u8 {
+        const names = switch (var_type) {
+            .boolean => self.variables.booleans.keys(),
+            .string => self.variables.strings.keys(),
+        };
+        return if (index < names.len) names[index] else null;
     }
 
     /// if the current node is an options node, choose the reply
     pub fn reply(self: *@This(), dialogue_id: usz, reply_index: usize) void {
         const currNode = self.currentNode(dialogue_id) orelse return;
         std.debug.assert(currNode == .reply);
+        if (self.trace) |recorder| recorder.record(.{ .reply = .{ .dialogue_id = dialogue_id, .reply_index = @intCast(reply_index) } });
         {
             @setRuntimeSafety(true);
             self.dialogues[dialogue_id].current_node_index = currNode.reply.nexts[reply_index].toOptionalInt(usz);
@@ -550,44 +1292,168 @@ pub const DialogueContext = struct {
     }
 
     pub fn step(self: *@This(), dialogue_id: usz) StepResult {
-        if (self.do_interpolate and self.step_result_buffer != null)
-            self.step_result_buffer.?.free(self.arena.allocator());
+        _ = self.scratch.reset(.retain_capacity);
+        return self.stepOne(dialogue_id);
+    }
+
+    pub const AdvanceResult = extern struct {
+        /// the number of lines written to the caller's buffer
+        line_count: usize,
+        /// the step which ended the batch, one of .options, .function_called or .done.
+        /// If the buffer filled up first, it is .line with no data, and advance can be called again
+        end: StepResult,
+    };
+
+    /// step until the next reply, call or end of the dialogue, writing every line on the way into
+    /// `lines_out`, so that hosts cross the FFI/wasm boundary once per batch instead of once per line.
+    /// With interpolation, the lines are valid until the next step, advance or peek
+    pub fn advance(self: *@This(), dialogue_id: usz, lines_out: []Line) AdvanceResult {
+        _ = self.scratch.reset(.retain_capacity);
+
+        var line_count: usize = 0;
+        while (line_count < lines_out.len) : (line_count += 1) {
+            const result = self.stepOne(dialogue_id);
+            if (result.tag != .line)
+                return .{ .line_count = line_count, .end = result };
+
+            lines_out[line_count] = result.data.line;
+        }
+
+        return .{ .line_count = line_count, .end = .{ .tag = .line } };
+    }
+
+    /// write up to `lines_out.len` upcoming lines without advancing the dialogue, e.g. to prefetch voice lines.
+    /// Stops early where what follows isn't known ahead of time: at a reply or call node.
+    /// Random switches are followed to the branch their next draws will take, without drawing.
+    /// Lock and unlock nodes are skipped over without being applied, since lines don't read true/false variables.
+    /// Nothing is recorded to the trace. Returns the number of lines written.
+    /// With interpolation, the lines are valid until the next step, advance or peek, and setting a string
+    /// variable before stepping may change the stepped lines
+    pub fn peek(self: *@This(), dialogue_id: usz, lines_out: []Line) usize {
+        _ = self.scratch.reset(.retain_capacity);
+
+        if (self.world) |world| world.state.beginRead(world.reader);
+        defer if (self.world) |world| world.state.endRead(world.reader);
+        const string_vars = StringVariables{ .ctx = self };
+
+        const dialogue = &self.dialogues[dialogue_id];
+        var maybe_node_index = dialogue.current_node_index;
+        var random_draws = dialogue.random_draws;
+
+        var line_count: usize = 0;
+        while (line_count < lines_out.len) {
+            const node_index = maybe_node_index orelse break;
+            switch (dialogue.nodes.get(node_index)) {
+                .line => |v| {
+                    lines_out[line_count] = self.stepLine(dialogue, node_index, 0, v.data, string_vars);
+                    line_count += 1;
+                    maybe_node_index = v.next.toOptionalInt(usz);
+                },
+                .lock => |v| maybe_node_index = v.next.toOptionalInt(usz),
+                .unlock => |v| maybe_node_index = v.next.toOptionalInt(usz),
+                .random_switch => |v| {
+                    // draws are a pure function of their index, so the outcome is already known
+                    const shot = counter_rng.float(self.random_seed, dialogue_id, random_draws);
+                    random_draws += 1;
+                    maybe_node_index = v.choose(shot).toOptionalInt(usz);
+                },
+                .reply, .call => break,
+            }
+        }
+
+        return line_count;
+    }
 
+    /// push a stepped event into the host's ring, if events are enabled. @see InitOpts.events
+    fn pushEvent(
+        self: *@This(),
+        dialogue_id: usz,
+        node_index: usz,
+        tag: EventRing.Event.Tag,
+        data: EventRing.Event.Data,
+    ) void {
+        const ring = self.events orelse return;
+        // a full ring counts the drop, the host can see it with EventRing.droppedCount
+        _ = ring.push(.{ .tag = tag, .dialogue_id = dialogue_id, .node_index = node_index, .data = data });
+    }
+
+    /// a line of a node as it is returned from stepping, read from the text store if compressed
+    /// and interpolated, in the scratch arena which the caller resets. `option_index` is 0 for a line node
+    fn stepLine(
+        self: *@This(),
+        dialogue: *const Dialogue,
+        node_index: usz,
+        option_index: usize,
+        line: Line,
+        string_vars: StringVariables,
+    ) Line {
+        var result = line;
+        if (dialogue.text_refs) |text_refs| {
+            const refs = text_refs.refs[text_refs.first[node_index] + 2 * option_index ..][0..2];
+            // copied out of the cache, since reading the text may evict its block
+            if (!refs[1].isNone())
+                result.metadata = OptSlice(u8).fromZig(self.copyToScratch(self.readText(refs[1])));
+            const text = self.readText(refs[0]);
+            // interpolating copies the text anyway
+            result.text = Slice(u8).fromZig(if (self.do_interpolate) text else self.copyToScratch(text));
+        }
+        return if (self.do_interpolate)
+            result.interpolate(self.scratch.allocator(), string_vars, self.output_encoding)
+        else
+            result;
+    }
+
+    /// only valid until the next read, @see TextStore.Cache.get
+    fn readText(self: *@This(), ref: TextStore.Ref) []const u8 {
+        return self.text_cache.get(self.arena.child_allocator, &self.text_store, ref) catch |e| std.debug.panic("{}", .{e});
+    }
+
+    fn copyToScratch(self: *@This(), text: []const u8) []const u8 {
+        // aligned in case it is utf16
+        const copy = self.scratch.allocator().alignedAlloc(u8, 2, text.len) catch |e| std.debug.panic("{}", .{e});
+        @memcpy(copy, text);
+        return copy;
+    }
+
+    /// the step results' texts are in the scratch arena, which the caller resets
+    fn stepOne(self: *@This(), dialogue_id: usz) StepResult {
         const dialogue = &self.dialogues[dialogue_id];
 
+        // world strings read while interpolating must not be reclaimed before they are copied
+        if (self.world) |world| world.state.beginRead(world.reader);
+        defer if (self.world) |world| world.state.endRead(world.reader);
+        const string_vars = StringVariables{ .ctx = self };
+
+        if (self.trace) |recorder| recorder.record(.{ .step = dialogue_id });
+
         // all returns in this function must set and then return this variable
         var result: StepResult = undefined;
-        defer self.step_result_buffer = result;
+        defer if (self.trace) |recorder| recorder.record(.{ .result = .{
+            .tag = @intFromEnum(result.tag),
+            .options = if (result.tag == .options) @intCast(result.data.options.ids.len) else 0,
+        } });
 
         while (true) {
-            const current_node = self.currentNode(dialogue_id) orelse return .{ .tag = .done };
+            const current_node = self.currentNode(dialogue_id) orelse {
+                result = .{ .tag = .done };
+                return result;
+            };
+            if (self.trace) |recorder| recorder.record(.{ .node = dialogue.current_node_index.? });
 
+            const node_index = dialogue.current_node_index.?;
             switch (current_node) {
                 .line => |v| {
+                    self.pushEvent(dialogue_id, node_index, .line, .{ .line = v.data });
                     // FIXME: technically this seems to mean nextNodeIndex!
                     dialogue.current_node_index = v.next.toOptionalInt(usz);
-                    result = .{ .tag = .line, .data = .{ .line = if (self.do_interpolate)
-                        v.data.interpolate(self.arena.allocator(), &self.variables.strings)
-                    else
-                        v.data } };
+                    result = .{ .tag = .line, .data = .{ .line = self.stepLine(dialogue, node_index, 0, v.data, string_vars) } };
                     return result;
                 },
                 .random_switch => |v| {
                     // guaranteed to be in [0, 1) range
-                    const shot = self.rand.random().float(f32);
-                    var acc: u64 = 0;
-                    for (v.nexts, v.chances) |next, chance_count| {
-                        acc += chance_count;
-                        const chance_proportion = @as(f64, @floatFromInt(acc)) / @as(f64, @floatFromInt(v.total_chances));
-                        if (shot < chance_proportion) {
-                            dialogue.current_node_index = next.toOptionalInt(usz);
-                            break;
-                        }
-                    }
-
-                    // just in case of fp error
-                    std.debug.assert(v.nexts.len >= 1);
-                    dialogue.current_node_index = v.nexts[v.nexts.len - 1].toOptionalInt(usz);
+                    const shot = self.drawRandom(dialogue_id);
+                    if (self.trace) |recorder| recorder.record(.{ .random = @bitCast(shot) });
+                    dialogue.current_node_index = v.choose(shot).toOptionalInt(usz);
                 },
                 .reply => |v| {
                     std.debug.assert(v.texts.len <= self.step_options_buffer.len);
@@ -596,23 +1462,21 @@ pub const DialogueContext = struct {
                     var slot_index: usize = 0;
                     for (v.texts.toZig(), v.conditions, 0..) |text, cond, index| {
                         switch (cond) {
-                            .locked => |bool_ptr| {
-                                const is_locked = !bool_ptr.*;
+                            .locked => |var_index| {
+                                const is_locked = !self.readBoolean(var_index);
                                 if (!is_locked) continue;
                             },
-                            .unlocked => |bool_ptr| {
-                                const is_unlocked = bool_ptr.*;
+                            .unlocked => |var_index| {
+                                const is_unlocked = self.readBoolean(var_index);
                                 if (!is_unlocked) continue;
                             },
+                            .expr => |program| {
+                                if (!program.eval(ConditionVariables{ .ctx = self })) continue;
+                            },
                             else => {},
                         }
 
-                        self.step_options_buffer.toZig()[slot_index] = if (self.do_interpolate)
-                            // FIXME/LEAK: should not use arena here! arena allocator won't free it
-                            // until dialogue ends, which means garbage grows indefinitely!
-                            text.interpolate(self.arena.allocator(), &self.variables.strings)
-                        else
-                            text;
+                        self.step_options_buffer.toZig()[slot_index] = self.stepLine(dialogue, node_index, index, text, string_vars);
 
                         self.step_option_ids_buffer.toZig()[slot_index] = index;
 
@@ -626,19 +1490,21 @@ pub const DialogueContext = struct {
                     return result;
                 },
                 .lock => |v| {
-                    self.variables.booleans.put(v.boolean_var_name, false)
                     // FIXME: validate lock variable names at start time
-                    catch |e| std.debug.panic("error getting variable '{s}' to lock: {}", .{ v.boolean_var_name, e });
+                    self.writeBoolean(self.booleanIndex(v.boolean_var_name), false);
+                    self.pushEvent(dialogue_id, node_index, .lock, .{ .variable = Slice(u8).fromZig(v.boolean_var_name) });
                     dialogue.current_node_index = v.next.toOptionalInt(usz);
                 },
                 .unlock => |v| {
-                    self.variables.booleans.put(v.boolean_var_name, true)
                     // FIXME: validate lock variable names at start time
-                    catch |e| std.debug.panic("error getting variable '{s}' to lock: {}", .{ v.boolean_var_name, e });
+                    self.writeBoolean(self.booleanIndex(v.boolean_var_name), true);
+                    self.pushEvent(dialogue_id, node_index, .unlock, .{ .variable = Slice(u8).fromZig(v.boolean_var_name) });
                     dialogue.current_node_index = v.next.toOptionalInt(usz);
                 },
                 .call => |v| {
-                    if (self.functions.get(v.function_name)) |stored_cb| if (stored_cb) |cb| cb.function(cb.payload);
+                    if (self.events != null) {
+                        self.pushEvent(dialogue_id, node_index, .call, .{ .call = Slice(u8).fromZig(v.function_name) });
+                    } else if (self.functions.get(v.function_name)) |stored_cb| if (stored_cb) |cb| cb.function(cb.payload);
                     dialogue.current_node_index = v.next.toOptionalInt(usz);
                     // the user must call 'step' again to get the real step
                     result = .{ .tag = .function_called };
@@ -656,15 +1522,20 @@ const ConditionJson = struct {
         none,
         locked,
         unlocked,
+        expr,
     } = .none,
 
     /// the name of the variable that the action acts upon
     variable: ?[]const u8 = null,
 
+    /// for the expr action, @see condition_vm.zig for the format
+    expr: ?json.Value = null,
+
     pub fn jsonParse(allocator: std.mem.Allocator, source: anytype, options: json.ParseOptions) !@This() {
         const value = try json.innerParse(struct {
             action: []const u8,
             variable: ?[]const u8 = null,
+            expr: ?json.Value = null,
         }, allocator, source, options);
 
         return if (std.mem.eql(u8, value.action, "none"))
@@ -673,6 +1544,8 @@ const ConditionJson = struct {
             .{ .action = .locked, .variable = value.variable orelse return error.MissingField }
         else if (std.mem.eql(u8, value.action, "unlocked"))
             .{ .action = .unlocked, .variable = value.variable orelse return error.MissingField }
+        else if (std.mem.eql(u8, value.action, "expr"))
+            .{ .action = .expr, .expr = value.expr orelse return error.MissingField }
         else
             error.UnexpectedToken;
     }
@@ -685,63 +1558,73 @@ const ReplyJson = struct {
     conditions: []const ConditionJson,
 };
 
-const DialogueJson = struct {
-    version: usize,
-    dialogues: json.ArrayHashMap(struct {
-        nodes: []const struct {
-            // FIXME: these must be in sync with the implementation of Node!
-            // TODO: generate these from Node type...
-            // NOTE: this scales poorly of course, custom json parsing would probably be better
-            line: ?@typeInfo(Node).Union.fields[0].type = null,
-            random_switch: ?struct {
-                nexts: []const Next,
-                chances: []const u32,
-            } = null,
-            // FIXME: update json schema
-            reply: ?ReplyJson = null,
-            lock: ?@typeInfo(Node).Union.fields[3].type = null,
-            unlock: ?@typeInfo(Node).Union.fields[4].type = null,
-            call: ?@typeInfo(Node).Union.fields[5].type = null,
-
-            /// convert from the json node format to the internal format
-            pub fn toNode(self: @This(), alloc: std.mem.Allocator, boolean_vars: *std.StringHashMap(bool)) ?Node {
-                if (self.line) |v| return .{ .line = v };
-                if (self.random_switch) |v| return .{ .random_switch = RandomSwitch.init(v.nexts, v.chances) };
-                if (self.reply) |v| return .{ .reply = Reply.initFromJson(alloc, v, boolean_vars) };
-                if (self.lock) |v| return .{ .lock = v };
-                if (self.unlock) |v| return .{ .unlock = v };
-                if (self.call) |v| return .{ .call = v };
-                return null;
-            }
+/// the json of each dialogue in a file
+const DialogueBodyJson = struct {
+    nodes: []const struct {
+        // FIXME: these must be in sync with the implementation of Node!
+        // TODO: generate these from Node type...
+        // NOTE: this scales poorly of course, custom json parsing would probably be better
+        line: ?@typeInfo(Node).Union.fields[0].type = null,
+        random_switch: ?struct {
+            nexts: []const Next,
+            chances: []const u32,
+        } = null,
+        // FIXME: update json schema
+        reply: ?ReplyJson = null,
+        lock: ?@typeInfo(Node).Union.fields[3].type = null,
+        unlock: ?@typeInfo(Node).Union.fields[4].type = null,
+        call: ?@typeInfo(Node).Union.fields[5].type = null,
+
+        /// convert from the json node format to the internal format
+        pub fn toNode(
+            self: @This(),
+            alloc: std.mem.Allocator,
+            program_alloc: std.mem.Allocator,
+            boolean_vars: *const std.StringArrayHashMap(bool),
+            string_vars: *const std.StringArrayHashMap(StringVariable),
+            diagnostic: *condition_vm.CompileDiagnostic,
+        ) condition_vm.CompileError!?Node {
+            if (self.line) |v| return .{ .line = v };
+            if (self.random_switch) |v| return .{ .random_switch = RandomSwitch.init(v.nexts, v.chances) };
+            if (self.reply) |v| return .{ .reply = try Reply.initFromJson(alloc, program_alloc, v, boolean_vars, string_vars, diagnostic) };
+            if (self.lock) |v| return .{ .lock = v };
+            if (self.unlock) |v| return .{ .unlock = v };
+            if (self.call) |v| return .{ .call = v };
+            return null;
+        }
 
-            // FIXME: add a deep clone utility
-            // FIXME: maybe I should just copy/own the json document?
-            pub fn toNodeAlloc(self: @This(), alloc: std.mem.Allocator) !?Node {
-                if (self.line) |v| return .{ .line = .{
-                    .data = .{
-                        .speaker = try alloc.dupe(u8, v.data.speaker),
-                        .text = try alloc.dupe(u8, v.data.text),
-                        .metadata = try alloc.dupe(u8, v.data.metadata),
-                    },
-                    .next = v.next,
+        // FIXME: add a deep clone utility
+        // FIXME: maybe I should just copy/own the json document?
+        pub fn toNodeAlloc(self: @This(), alloc: std.mem.Allocator) !?Node {
+            if (self.line) |v| return .{ .line = .{
+                .data = .{
+                    .speaker = try alloc.dupe(u8, v.data.speaker),
+                    .text = try alloc.dupe(u8, v.data.text),
+                    .metadata = try alloc.dupe(u8, v.data.metadata),
+                },
+                .next = v.next,
+            } };
+            if (self.random_switch) |v| return .{ .random_switch = RandomSwitch.init(
+                try alloc.dupe(Next, v.nexts),
+                try alloc.dupe(u32, v.chances),
+            ) };
+            if (self.reply) |v| {
+                return .{ .reply = .{
+                    .nexts = alloc.dupe(Next, v.nexts),
+                    .texts = alloc.dupe(Slice(u8), v.texts),
                 } };
-                if (self.random_switch) |v| return .{ .random_switch = RandomSwitch.init(
-                    try alloc.dupe(Next, v.nexts),
-                    try alloc.dupe(u32, v.chances),
-                ) };
-                if (self.reply) |v| {
-                    return .{ .reply = .{
-                        .nexts = alloc.dupe(Next, v.nexts),
-                        .texts = alloc.dupe(Slice(u8), v.texts),
-                    } };
-                }
-                if (self.lock) |v| return .{ .lock = v };
-                if (self.unlock) |v| return .{ .unlock = v };
-                if (self.call) |v| return .{ .call = v };
-                return null;
             }
-        },
-    }),
+            if (self.lock) |v| return .{ .lock = v };
+            if (self.unlock) |v| return .{ .unlock = v };
+            if (self.call) |v| return .{ .call = v };
+            return null;
+        }
+    },
+};
+
+const DialogueJson = struct {
+    version: usize,
+    dialogues: json.ArrayHashMap(DialogueBodyJson),
     functions: []const struct { name: []const u8 } = &.{},
     participants: []const struct { name: []const u8 } = &.{},
     variables: struct {
@@ -753,6 +1636,10 @@ const DialogueJson = struct {
     },
 };
 
+test {
+    _ = @import("./explorer.zig");
+}
+
 test "run small dialogue under zig api" {
     const src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/simple1.alternis.json");
     defer src.free(t.allocator);
@@ -938,3 +1825,583 @@ test "run large dialogue under zig api" {
         try t.expectEqual(@as(?usz, null), ctx.getCurrentNodeIndex(0));
     }
 }
+
+test "advance and peek return batches of lines" {
+    const src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/sample1.alternis.json");
+    defer src.free(t.allocator);
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    var ctx = try DialogueContext.initFromJson(src.buffer, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer ctx.deinit(t.allocator);
+
+    errdefer |e| std.debug.print("\nerr {}: '{s}'", .{ e, diagnostic.error_message.toZig() });
+
+    var lines: [8]Line = undefined;
+
+    // follows the random switch to the branch it will take, and stops at the call
+    try t.expectEqual(@as(usize, 3), ctx.peek(0, &lines));
+    try t.expectEqualStrings("Hey", lines[0].text.toZig());
+    try t.expectEqualStrings("Yo", lines[1].text.toZig());
+    try t.expectEqual(@as(?usz, 0), ctx.getCurrentNodeIndex(0));
+    try t.expectEqual(@as(u64, 0), ctx.randomDraws(0));
+
+    {
+        const result = ctx.advance(0, &lines);
+        try t.expect(result.end.tag == .function_called);
+        try t.expectEqual(@as(usize, 3), result.line_count);
+        try t.expectEqualStrings("Hey", lines[0].text.toZig());
+        try t.expectEqualStrings("Yo", lines[1].text.toZig());
+        try t.expectEqualStrings("What's your name?", lines[2].text.toZig());
+        try t.expectEqual(@as(?usz, 5), ctx.getCurrentNodeIndex(0));
+    }
+
+    {
+        const result = ctx.advance(0, &lines);
+        try t.expect(result.end.tag == .options);
+        try t.expectEqual(@as(usize, 0), result.line_count);
+        try t.expectEqual(@as(usize, 2), result.end.data.options.ids.len);
+    }
+
+    ctx.reply(0, 1);
+
+    try t.expectEqual(@as(usize, 1), ctx.peek(0, &lines));
+    try t.expectEqualStrings("Ok. What was your name again?", lines[0].text.toZig());
+    try t.expectEqual(@as(?usz, 8), ctx.getCurrentNodeIndex(0));
+
+    // a full buffer ends the batch early
+    {
+        const result = ctx.advance(0, lines[0..1]);
+        try t.expect(result.end.tag == .line);
+        try t.expectEqual(@as(usize, 1), result.line_count);
+        try t.expectEqualStrings("Ok. What was your name again?", lines[0].text.toZig());
+        try t.expectEqual(@as(?usz, 5), ctx.getCurrentNodeIndex(0));
+    }
+}
+
+test "setting string variables often keeps memory constant" {
+    const src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/sample1.alternis.json");
+    defer src.free(t.allocator);
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    var ctx = try DialogueContext.initFromJson(src.buffer, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer ctx.deinit(t.allocator);
+
+    errdefer |e| std.debug.print("\nerr {}: '{s}'", .{ e, diagnostic.error_message.toZig() });
+
+    // step to the options, which interpolate the name
+    while (ctx.step(0).tag != .options) {}
+
+    var name_buffer: [64]u8 = undefined;
+    var first_report: ?DialogueContext.MemoryReport = null;
+    for (0..200) |i| {
+        // alternate between inline and buffered values
+        const name = try std.fmt.bufPrint(&name_buffer, "{s} the {}th", .{ if (i % 2 == 0) "Testy" else "Testy McTester of the Testing Realm", i % 10 });
+        ctx.setVariableString("name", name);
+        try t.expectEqualStrings(name, ctx.getVariableString("name").?);
+
+        const result = ctx.step(0);
+        try t.expect(result.tag == .options);
+        try t.expect(std.mem.startsWith(u8, result.data.options.texts.ptr[1].text.toZig(), "It's Testy"));
+
+        // after a few steps for the scratch arena to settle on its capacity
+        const report = ctx.memoryReport();
+        if (i == 3) first_report = report;
+        if (i > 3) try t.expectEqual(first_report.?, report);
+    }
+
+    try t.expect(ctx.memoryReport().variables > 0);
+    try t.expect(ctx.memoryReport().nodes > 0);
+}
+
+test "dialogues compiled in parallel match compiling on one thread" {
+    const dialogue_count = 40;
+
+    var src = std.ArrayList(u8).init(t.allocator);
+    defer src.deinit();
+    try src.appendSlice("{\"version\": 1, \"dialogues\": {");
+    for (0..dialogue_count) |i| {
+        if (i != 0) try src.append(',');
+        try src.writer().print(
+            \"d{}": {{"nodes": [
+            \  {{"line": {{"data": {{"speaker": "a", "text": "line {}"}}, "next": 1}}}},
+            \  {{"reply": {{"nexts": [0, null], "texts": [{{"speaker": "b", "text": "again"}}, {{"speaker": "b", "text": "bye"}}], "conditions": [
+            \    {{"action": "expr", "expr": {{"not": {{"var": "done"}}}}}}, {{"action": "none"}}
+            \  ]}}}}
+            \]}}
+        , .{ i, i });
+    }
+    try src.appendSlice("}, \"variables\": {\"boolean\": [{\"name\": \"done\"}]}}");
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    var sequential = try DialogueContext.initFromJson(src.items, t.allocator, .{ .random_seed = 0, .compile_thread_count = 1 }, &diagnostic);
+    defer sequential.deinit(t.allocator);
+    var parallel = try DialogueContext.initFromJson(src.items, t.allocator, .{ .random_seed = 0, .compile_thread_count = 4 }, &diagnostic);
+    defer parallel.deinit(t.allocator);
+    // the chunks' texts are kept apart from their programs
+    var compressed = try DialogueContext.initFromJson(src.items, t.allocator, .{ .random_seed = 0, .compile_thread_count = 4, .compress_text = true }, &diagnostic);
+    defer compressed.deinit(t.allocator);
+
+    try t.expectEqual(sequential.dialogues.len, parallel.dialogues.len);
+    try t.expectEqual(sequential.step_options_buffer.len, parallel.step_options_buffer.len);
+    for (sequential.dialogues, parallel.dialogues, 0..) |a, b, i| {
+        try t.expectEqualStrings(a.name, b.name);
+        try t.expectEqual(a.nodes.len, b.nodes.len);
+
+        const a_line = sequential.step(@intCast(i));
+        const b_line = parallel.step(@intCast(i));
+        try t.expectEqualStrings(a_line.data.line.text.toZig(), b_line.data.line.text.toZig());
+        const b_options = parallel.step(@intCast(i));
+        try t.expectEqualSlices(usize, &.{ 0, 1 }, b_options.data.options.ids.toZig());
+
+        const c_line = compressed.step(@intCast(i));
+        try t.expectEqualStrings(a_line.data.line.text.toZig(), c_line.data.line.text.toZig());
+        const c_options = compressed.step(@intCast(i));
+        try t.expectEqualSlices(usize, &.{ 0, 1 }, c_options.data.options.ids.toZig());
+    }
+
+    // the first failed dialogue is reported, however the work was scheduled
+    const bad_src = try std.mem.replaceOwned(u8, t.allocator, src.items, "\"text\": \"line 7\"}, \"next\": 1", "\"text\": \"line 7\"}, \"next\": 70");
+    defer t.allocator.free(bad_src);
+    const worse_src = try std.mem.replaceOwned(u8, t.allocator, bad_src, "\"text\": \"line 30\"}, \"next\": 1", "\"text\": \"line 30\"}, \"next\": 300");
+    defer t.allocator.free(worse_src);
+    try t.expectError(error.AlternisBadNextNode, DialogueContext.initFromJson(worse_src, t.allocator, .{ .random_seed = 0, .compile_thread_count = 4 }, &diagnostic));
+    try t.expectEqualStrings("bad next node '70' on node '0'", diagnostic.error_message.toZig());
+    diagnostic.free(t.allocator);
+}
+
+test "shared context steps independently of its source" {
+    const src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/sample1.alternis.json");
+    defer src.free(t.allocator);
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    var source = try DialogueContext.initFromJson(src.buffer, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer source.deinit(t.allocator);
+
+    errdefer |e| std.debug.print("\nerr {}: '{s}'", .{ e, diagnostic.error_message.toZig() });
+
+    source.setVariableBoolean("Aaron likes you", true);
+    _ = source.step(0);
+
+    var shared = try DialogueContext.initShared(&source, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer shared.deinit(t.allocator);
+
+    try t.expectEqual(@as(?usz, 1), source.getCurrentNodeIndex(0));
+    try t.expectEqual(@as(?usz, 0), shared.getCurrentNodeIndex(0));
+    try t.expect(!shared.getVariableBoolean("Aaron likes you"));
+
+    {
+        const step_result = shared.step(0);
+        try t.expect(step_result.tag == .line);
+        try t.expectEqualStrings("Aisha", step_result.data.line.speaker.toZig());
+        try t.expectEqualStrings("Hey", step_result.data.line.text.toZig());
+    }
+
+    shared.reset(0, 5);
+    {
+        const step_result = shared.step(0);
+        try t.expect(step_result.tag == .options);
+        // the unlock in the source context is not visible here
+        try t.expectEqual(@as(usize, 2), step_result.data.options.texts.len);
+    }
+}
+
+test "utf16 output encoding" {
+    const src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/simple1.alternis.json");
+    defer src.free(t.allocator);
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    var ctx = try DialogueContext.initFromJson(src.buffer, t.allocator, .{ .random_seed = 0, .output_encoding = .utf16 }, &diagnostic);
+    defer ctx.deinit(t.allocator);
+
+    const expected_speaker = try text_encoding.utf8ToUtf16LeBytes(t.allocator, "test");
+    defer t.allocator.free(@as([]const u16, @alignCast(std.mem.bytesAsSlice(u16, expected_speaker))));
+    const expected_text = try text_encoding.utf8ToUtf16LeBytes(t.allocator, "hello world!");
+    defer t.allocator.free(@as([]const u16, @alignCast(std.mem.bytesAsSlice(u16, expected_text))));
+
+    const step_result = ctx.step(0);
+    try t.expect(step_result.tag == .line);
+    try t.expectEqualSlices(u8, expected_speaker, step_result.data.line.speaker.toZig());
+    try t.expectEqualSlices(u8, expected_text, step_result.data.line.text.toZig());
+}
+
+test "compressed texts step the same and take less memory" {
+    const line_count = 300;
+
+    var src = std.ArrayList(u8).init(t.allocator);
+    defer src.deinit();
+    try src.appendSlice("{\"version\": 1, \"dialogues\": {\"d\": {\"nodes\": [");
+    for (0..line_count) |i| try src.writer().print(
+        \\{{"line": {{"data": {{"speaker": "Aaron", "text": "line {}: You're pretty cool, {{name}}! What was your name again?", "metadata": "voice/aaron_{}.ogg"}}, "next": {}}}}},
+    , .{ i, i, i + 1 });
+    try src.appendSlice(
+        \\{"reply": {"nexts": [0, null], "texts": [{"speaker": "Aisha", "text": "Again, {name}"}, {"speaker": "Aisha", "text": "Bye", "metadata": "wave"}],
+        \\  "conditions": [{"action": "expr", "expr": {"not": {"eq": [{"var": "name"}, {"str": "Aaron"}]}}}, {"action": "none"}]}}
+        \\]}}, "variables": {"string": [{"name": "name"}]}}
+    );
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    var plain = try DialogueContext.initFromJson(src.items, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer plain.deinit(t.allocator);
+    var compressed = try DialogueContext.initFromJson(src.items, t.allocator, .{ .random_seed = 0, .compress_text = true, .text_cache_blocks = 2 }, &diagnostic);
+    defer compressed.deinit(t.allocator);
+    var shared = try DialogueContext.initShared(&compressed, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer shared.deinit(t.allocator);
+
+    try t.expect(compressed.memoryReport().text * 2 < plain.memoryReport().text);
+
+    for ([_]*DialogueContext{ &compressed, &shared }) |ctx| {
+        ctx.setVariableString("name", "Testy");
+        plain.setVariableString("name", "Testy");
+        plain.reset(0, 0);
+
+        // twice through, so that evicted blocks are decompressed again
+        for (0..2) |_| {
+            for (0..line_count) |_| {
+                const expected = plain.step(0);
+                const actual = ctx.step(0);
+                try t.expect(actual.tag == .line);
+                try t.expectEqualStrings(expected.data.line.speaker.toZig(), actual.data.line.speaker.toZig());
+                try t.expectEqualStrings(expected.data.line.text.toZig(), actual.data.line.text.toZig());
+                try t.expectEqualStrings(expected.data.line.metadata.toZig().?, actual.data.line.metadata.toZig().?);
+            }
+
+            const expected = plain.step(0);
+            const actual = ctx.step(0);
+            try t.expect(actual.tag == .options);
+            try t.expectEqualSlices(usize, expected.data.options.ids.toZig(), actual.data.options.ids.toZig());
+            for (expected.data.options.texts.toZig(), actual.data.options.texts.toZig()) |expected_text, actual_text| {
+                try t.expectEqualStrings(expected_text.text.toZig(), actual_text.text.toZig());
+                try t.expectEqual(expected_text.metadata.toZig() == null, actual_text.metadata.toZig() == null);
+            }
+            plain.reply(0, 0);
+            ctx.reply(0, 0);
+        }
+    }
+
+    var lines: [4]Line = undefined;
+    try t.expectEqual(@as(usize, 4), shared.peek(0, &lines));
+    try t.expectEqualStrings("line 2: You're pretty cool, Testy! What was your name again?", lines[2].text.toZig());
+    try t.expectEqualStrings("voice/aaron_3.ogg", lines[3].metadata.toZig().?);
+}
+
+test "world state variables are shared between contexts" {
+    const src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/sample1.alternis.json");
+    defer src.free(t.allocator);
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    var world = try WorldState.init(t.allocator, &.{"Aaron likes you"}, &.{"name"});
+    defer world.deinit();
+
+    var ctx = try DialogueContext.initFromJson(src.buffer, t.allocator, .{ .random_seed = 0, .world_state = &world }, &diagnostic);
+    defer ctx.deinit(t.allocator);
+
+    var shared = try DialogueContext.initShared(&ctx, t.allocator, .{ .random_seed = 0, .world_state = &world }, &diagnostic);
+    defer shared.deinit(t.allocator);
+
+    world.setBoolean(world.getBooleanIndex("Aaron likes you").?, true);
+    // writing through a bound context writes the world state
+    ctx.setVariableString("name", "Testy McTester");
+
+    for ([_]*DialogueContext{ &ctx, &shared }) |each| {
+        try t.expect(each.getVariableBoolean("Aaron likes you"));
+        each.reset(0, 5);
+        const step_result = each.step(0);
+        try t.expect(step_result.tag == .options);
+        try t.expectEqual(@as(usize, 3), step_result.data.options.texts.len);
+        try t.expectEqualStrings("It's Testy McTester", step_result.data.options.texts.ptr[1].text.toZig());
+    }
+
+    // an unlock node stepped in one context unlocks it for every context
+    ctx.setVariableBoolean("Aaron likes you", false);
+    try t.expect(!shared.getVariableBoolean("Aaron likes you"));
+    shared.reply(0, 0);
+    _ = shared.step(0);
+    try t.expect(ctx.getVariableBoolean("Aaron likes you"));
+
+    // a world string read is a copy, so another context replacing it doesn't free it
+    const read_name = shared.getVariableString("name").?;
+    ctx.setVariableString("name", "Bert");
+    world.collectGarbage();
+    try t.expectEqual(@as(usize, 0), world.retired.items.len);
+    try t.expectEqualStrings("Testy McTester", read_name);
+    try t.expectEqualStrings("Bert", shared.getVariableString("name").?);
+}
+
+test "stepping pushes events instead of calling callbacks" {
+    const src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/sample1.alternis.json");
+    defer src.free(t.allocator);
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    var event_buffer: [8]EventRing.Event = undefined;
+    var events = EventRing.init(&event_buffer);
+
+    var ctx = try DialogueContext.initFromJson(src.buffer, t.allocator, .{ .random_seed = 0, .events = &events }, &diagnostic);
+    defer ctx.deinit(t.allocator);
+
+    const Counter = struct {
+        fn impl(payload: ?*anyopaque) callconv(.C) void {
+            const calls: *usize = @alignCast(@ptrCast(payload));
+            calls.* += 1;
+        }
+    };
+    var calls: usize = 0;
+    ctx.setCallback("ask player name", .{ .function = &Counter.impl, .payload = &calls });
+
+    var lines: [8]Line = undefined;
+    try t.expect(ctx.advance(0, &lines).end.tag == .function_called);
+    try t.expectEqual(@as(usize, 0), calls);
+
+    var out: [8]EventRing.Event = undefined;
+    {
+        const drained = out[0..events.drain(&out)];
+        try t.expectEqual(@as(usize, 4), drained.len);
+        try t.expectEqual(EventRing.Event.Tag.line, drained[0].tag);
+        try t.expectEqualStrings("Hey", drained[0].data.line.text.toZig());
+        try t.expectEqualStrings("Yo", drained[1].data.line.text.toZig());
+        try t.expectEqual(@as(usz, 10), drained[1].node_index);
+        try t.expectEqualStrings("What's your name?", drained[2].data.line.text.toZig());
+        try t.expectEqual(EventRing.Event.Tag.call, drained[3].tag);
+        try t.expectEqualStrings("ask player name", drained[3].data.call.toZig());
+        try t.expectEqual(@as(usz, 4), drained[3].node_index);
+    }
+
+    try t.expect(ctx.step(0).tag == .options);
+    ctx.reply(0, 0);
+    _ = ctx.step(0);
+
+    {
+        const drained = out[0..events.drain(&out)];
+        try t.expectEqual(@as(usize, 2), drained.len);
+        try t.expectEqual(EventRing.Event.Tag.unlock, drained[0].tag);
+        try t.expectEqualStrings("Aaron likes you", drained[0].data.variable.toZig());
+        try t.expectEqual(EventRing.Event.Tag.line, drained[1].tag);
+        try t.expectEqual(@as(usz, 7), drained[1].node_index);
+    }
+    try t.expectEqual(@as(usize, 0), events.droppedCount());
+}
+
+test "variable changes are logged with sequence numbers and dirty flags" {
+    const src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/sample1.alternis.json");
+    defer src.free(t.allocator);
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    var ctx = try DialogueContext.initFromJson(src.buffer, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer ctx.deinit(t.allocator);
+
+    try t.expectEqual(@as(u64, 0), ctx.latestChangeSeq());
+    ctx.setVariableString("name", "Testy McTester");
+    ctx.setVariableString("name", "Testy McTester"); // unchanged
+
+    // the unlock node changes a boolean while stepping
+    var lines: [8]Line = undefined;
+    _ = ctx.advance(0, &lines);
+    _ = ctx.step(0);
+    ctx.reply(0, 0);
+    _ = ctx.step(0);
+
+    var changes: [8]ChangeLog.Change = undefined;
+    const result = ctx.changesSince(0, &changes);
+    try t.expect(!result.missed);
+    try t.expectEqual(@as(usize, 2), result.count);
+
+    try t.expectEqual(ChangeLog.VariableType.string, changes[0].type);
+    try t.expectEqualStrings("name", ctx.variableName(.string, changes[0].index).?);
+    try t.expectEqualStrings("<UNSET>", changes[0].old_string.toZig());
+    try t.expectEqualStrings("Testy McTester", changes[0].new_string.toZig());
+
+    try t.expectEqual(ChangeLog.VariableType.boolean, changes[1].type);
+    try t.expectEqual(@as(u64, 2), changes[1].seq);
+    try t.expectEqualStrings("Aaron likes you", ctx.variableName(.boolean, changes[1].index).?);
+    try t.expect(!changes[1].old_boolean and changes[1].new_boolean);
+
+    try t.expectEqual(@as(usize, 0), ctx.changesSince(ctx.latestChangeSeq(), &changes).count);
+
+    var dirty: [4]usz = undefined;
+    try t.expectEqual(@as(usize, 1), ctx.takeDirtyVariables(.boolean, &dirty));
+    try t.expectEqual(@as(usize, 0), ctx.takeDirtyVariables(.boolean, &dirty));
+    try t.expectEqual(@as(usize, 1), ctx.takeDirtyVariables(.string, &dirty));
+}
+
+test "random switch outcomes follow each dialogue's own random stream" {
+    const src =
+        \\{"version": 1, "dialogues": {
+        \\  "a": {"nodes": [
+        \\    {"random_switch": {"nexts": [1, 2], "chances": [1, 1]}},
+        \\    {"line": {"data": {"speaker": "a", "text": "heads"}}},
+        \\    {"line": {"data": {"speaker": "a", "text": "tails"}}}
+        \\  ]},
+        \\  "b": {"nodes": [
+        \\    {"random_switch": {"nexts": [1, 2], "chances": [1, 1]}},
+        \\    {"line": {"data": {"speaker": "b", "text": "heads"}}},
+        \\    {"line": {"data": {"speaker": "b", "text": "tails"}}}
+        \\  ]}
+        \\}}
+    ;
+    const seed = 7;
+    const flips = 8;
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    // the outcome of each flip is the branch its draw lands on
+    var expected: [flips][]const u8 = undefined;
+    var heads: usize = 0;
+    for (&expected, 0..) |*text, i| {
+        const is_heads = counter_rng.float(seed, 0, i) < 0.5;
+        if (is_heads) heads += 1;
+        text.* = if (is_heads) "heads" else "tails";
+    }
+    // the seed must flip both ways for the test to mean anything
+    try t.expect(heads > 0 and heads < flips);
+
+    var alone = try DialogueContext.initFromJson(src, t.allocator, .{ .random_seed = seed }, &diagnostic);
+    defer alone.deinit(t.allocator);
+    var interleaved = try DialogueContext.initFromJson(src, t.allocator, .{ .random_seed = seed }, &diagnostic);
+    defer interleaved.deinit(t.allocator);
+
+    var lines: [1]Line = undefined;
+    for (expected) |text| {
+        // peeking follows the switch without drawing
+        try t.expectEqual(@as(usize, 1), alone.peek(0, &lines));
+        try t.expectEqualStrings(text, lines[0].text.toZig());
+        try t.expectEqualStrings(text, alone.step(0).data.line.text.toZig());
+        alone.reset(0, 0);
+
+        // stepping the other dialogue in between doesn't change a dialogue's outcomes
+        _ = interleaved.step(1);
+        interleaved.reset(1, 0);
+        try t.expectEqualStrings(text, interleaved.step(0).data.line.text.toZig());
+        interleaved.reset(0, 0);
+    }
+    try t.expectEqual(@as(u64, flips), alone.randomDraws(0));
+    try t.expectEqual(@as(u64, flips), interleaved.randomDraws(1));
+
+    // restoring the draw count reproduces the following outcomes
+    alone.setRandomDraws(0, 3);
+    try t.expectEqualStrings(expected[3], alone.step(0).data.line.text.toZig());
+    try t.expectEqual(@as(u64, 4), alone.randomDraws(0));
+
+    // a shared context starts its own streams from the start
+    var shared = try DialogueContext.initShared(&alone, t.allocator, .{ .random_seed = seed }, &diagnostic);
+    defer shared.deinit(t.allocator);
+    try t.expectEqualStrings(expected[0], shared.step(0).data.line.text.toZig());
+}
+
+test "recorded trace replays without diverging" {
+    const src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/sample1.alternis.json");
+    defer src.free(t.allocator);
+
+    const Collect = struct {
+        fn write(user: ?*anyopaque, ptr: [*]const u8, len: usize) callconv(.C) void {
+            const list: *std.ArrayList(u8) = @alignCast(@ptrCast(user.?));
+            list.appendSlice(ptr[0..len]) catch unreachable;
+        }
+    };
+
+    var trace_bytes = std.ArrayList(u8).init(t.allocator);
+    defer trace_bytes.deinit();
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    {
+        var buffer: [64]u8 = undefined;
+        var recorder = trace.Recorder.init(&buffer, .{ .write = Collect.write, .user = &trace_bytes });
+        defer recorder.flush();
+
+        var ctx = try DialogueContext.initFromJson(src.buffer, t.allocator, .{ .random_seed = 0, .trace = &recorder }, &diagnostic);
+        defer ctx.deinit(t.allocator);
+
+        const SetNameCallback = struct {
+            pub fn impl(payload: ?*anyopaque) callconv(.C) void {
+                var dialogue_ctx: *DialogueContext = @alignCast(@ptrCast(payload orelse unreachable));
+                dialogue_ctx.setVariableString("name", "Testy McTester");
+            }
+        };
+        ctx.setCallback("ask player name", .{ .function = &SetNameCallback.impl, .payload = &ctx });
+
+        for (0..5) |_| _ = ctx.step(0);
+        ctx.reply(0, 0);
+        for (0..2) |_| _ = ctx.step(0);
+        ctx.reply(0, 2);
+        while (ctx.step(0).tag != .done) {}
+
+        // restoring the draws, e.g. from a save, takes the random switch's other branch
+        ctx.reset(0, 0);
+        ctx.setRandomDraws(0, 6);
+        _ = ctx.step(0);
+        try t.expectEqualStrings("WELL HELLO", ctx.step(0).data.line.text.toZig());
+    }
+
+    const replay = @import("./replay.zig").replay;
+
+    const result = try replay(t.allocator, src.buffer, trace_bytes.items, &diagnostic);
+    try t.expectEqual(@as(?usize, null), result.diverged_at);
+    try t.expectEqual(@as(usize, 11), result.steps);
+
+    // a different dialogue diverges
+    const other_src = try FileBuffer.fromDirAndPath(t.allocator, std.fs.cwd(), "./test/assets/simple1.alternis.json");
+    defer other_src.free(t.allocator);
+    const other_result = try replay(t.allocator, other_src.buffer, trace_bytes.items, &diagnostic);
+    try t.expect(other_result.diverged_at != null);
+}
+
+test "condition expressions" {
+    const src =
+        \\{"version": 1, "dialogues": {"d": {"nodes": [
+        \\  {"reply": {"nexts": [null, null, null], "texts": [
+        \\    {"speaker": "a", "text": "rich"}, {"speaker": "a", "text": "arthur"}, {"speaker": "a", "text": "always"}
+        \\  ], "conditions": [
+        \\    {"action": "expr", "expr": {"and": [{"var": "met the king"}, {"gte": [{"var": "gold"}, {"num": 100}]}]}},
+        \\    {"action": "expr", "expr": {"or": [{"not": {"var": "met the king"}}, {"eq": [{"var": "king"}, {"str": "Arthur"}]}]}},
+        \\    {"action": "none"}
+        \\  ]}}
+        \\]}}, "variables": {"boolean": [{"name": "met the king"}], "string": [{"name": "gold"}, {"name": "king"}]}}
+    ;
+
+    var diagnostic = DialogueContext.Diagnostic{};
+    errdefer diagnostic.free(t.allocator);
+
+    var ctx = try DialogueContext.initFromJson(src, t.allocator, .{ .random_seed = 0 }, &diagnostic);
+    defer ctx.deinit(t.allocator);
+
+    ctx.setVariableBoolean("met the king", true);
+    ctx.setVariableString("gold", "150");
+    ctx.setVariableString("king", "Bert");
+    {
+        const step_result = ctx.step(0);
+        try t.expect(step_result.tag == .options);
+        try t.expectEqualSlices(usize, &.{ 0, 2 }, step_result.data.options.ids.toZig());
+    }
+
+    ctx.setVariableString("gold", "20");
+    ctx.setVariableString("king", "Arthur");
+    {
+        const step_result = ctx.step(0);
+        try t.expectEqualSlices(usize, &.{ 1, 2 }, step_result.data.options.ids.toZig());
+    }
+
+    // type errors are reported when loading
+    const bad_src = try std.mem.replaceOwned(u8, t.allocator, src, "{\"str\": \"Arthur\"}", "{\"num\": 1}");
+    defer t.allocator.free(bad_src);
+    try t.expectError(error.AlternisBadCondition, DialogueContext.initFromJson(bad_src, t.allocator, .{ .random_seed = 0 }, &diagnostic));
+    diagnostic.free(t.allocator);
+}
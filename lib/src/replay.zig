@@ -0,0 +1,142 @@
+//! Re-run a trace against a dialogue as fast as possible, checking that it steps exactly as
+//! it did when recorded. The inputs of the trace are applied to a fresh context which records
+//! its own trace, and that is compared byte for byte with the original.
+//! @see trace.zig
+
+const std = @import("std");
+const DialogueContext = @import("./main.zig").DialogueContext;
+const trace = @import("./trace.zig");
+const usz = @import("./config.zig").usz;
+
+pub const Result = struct {
+    /// the amount of steps replayed
+    steps: usize = 0,
+    /// the byte offset in the trace where the replay first differed from it, if it did
+    diverged_at: ?usize = null,
+};
+
+/// compares the replaying context's trace with the original as it is flushed
+const Comparer = struct {
+    expected: []const u8,
+    offset: usize = 0,
+    diverged_at: ?usize = null,
+
+    fn write(user: ?*anyopaque, ptr: [*]const u8, len: usize) callconv(.C) void {
+        const self: *@This() = @alignCast(@ptrCast(user.?));
+        defer self.offset += len;
+        if (self.diverged_at != null) return;
+
+        const expected = self.expected[@min(self.offset, self.expected.len)..];
+        const actual = ptr[0..len];
+        if (std.mem.indexOfDiff(u8, expected[0..@min(expected.len, len)], actual)) |diff_index|
+            self.diverged_at = self.offset + diff_index;
+    }
+};
+
+const Replayer = struct {
+    ctx: *DialogueContext,
+    reader: trace.Reader,
+
+    fn applyInput(self: *@This(), event: trace.Event) error{InvalidTraceEvent}!void {
+        switch (event) {
+            .reply => |v| {
+                const dialogue = &self.ctx.dialogues[try self.checkDialogueId(v.dialogue_id)];
+                const node_index = dialogue.current_node_index orelse return error.InvalidTraceEvent;
+                if (dialogue.nodes.items(.tags)[node_index] != .reply) return error.InvalidTraceEvent;
+                if (v.reply_index >= dialogue.nodes.items(.data)[node_index].reply.nexts.len) return error.InvalidTraceEvent;
+                self.ctx.reply(v.dialogue_id, v.reply_index);
+            },
+            .reset => |v| {
+                const dialogue = &self.ctx.dialogues[try self.checkDialogueId(v.dialogue_id)];
+                if (v.node_index >= dialogue.nodes.len) return error.InvalidTraceEvent;
+                self.ctx.reset(v.dialogue_id, v.node_index);
+            },
+            .set_boolean => |v| {
+                const names = self.ctx.variables.booleans.keys();
+                if (v.var_index >= names.len) return error.InvalidTraceEvent;
+                self.ctx.setVariableBoolean(names[v.var_index], v.value);
+            },
+            .set_string => |v| {
+                if (!self.ctx.variables.strings.contains(v.name)) return error.InvalidTraceEvent;
+                self.ctx.setVariableString(v.name, v.value);
+            },
+            .set_random_draws => |v| self.ctx.setRandomDraws(try self.checkDialogueId(v.dialogue_id), v.draws),
+            else => return error.InvalidTraceEvent,
+        }
+    }
+
+    fn checkDialogueId(self: *@This(), dialogue_id: usz) error{InvalidTraceEvent}!usz {
+        if (dialogue_id >= self.ctx.dialogues.len) return error.InvalidTraceEvent;
+        return dialogue_id;
+    }
+
+    /// the host's callbacks may write variables, those writes were recorded right after the call node
+    fn onCall(payload: ?*anyopaque) callconv(.C) void {
+        const all_callbacks_payload: *DialogueContext.SetAllCallbacksPayload = @alignCast(@ptrCast(payload.?));
+        const self: *@This() = @alignCast(@ptrCast(all_callbacks_payload.inner_payload.?));
+
+        // skip the events of this step up to the call node, which were already replayed
+        while (self.reader.peek() catch null) |event| switch (event) {
+            .node, .random => _ = self.reader.next() catch unreachable,
+            else => break,
+        };
+
+        // a bad input surfaces as a divergence when the traces are compared
+        while (self.reader.peek() catch null) |event| {
+            if (!event.isInput()) break;
+            _ = self.reader.next() catch unreachable;
+            self.applyInput(event) catch break;
+        }
+    }
+};
+
+pub const ReplayError = trace.ReadError || DialogueContext.InitFromJsonError;
+
+/// `diagnostic` is set if creating the context fails
+pub fn replay(
+    alloc: std.mem.Allocator,
+    dialogue_json: []const u8,
+    trace_bytes: []const u8,
+    diagnostic: *DialogueContext.Diagnostic,
+) ReplayError!Result {
+    const reader, const seed = try trace.Reader.init(trace_bytes);
+
+    var comparer = Comparer{ .expected = trace_bytes };
+    var buffer: [4096]u8 = undefined;
+    var recorder = trace.Recorder.init(&buffer, .{ .write = Comparer.write, .user = &comparer });
+
+    // interpolation doesn't affect how the dialogue steps, so skip it
+    var ctx = try DialogueContext.initFromJson(dialogue_json, alloc, .{
+        .random_seed = seed,
+        .no_interpolate = true,
+        .trace = &recorder,
+    }, diagnostic);
+    defer ctx.deinit(alloc);
+
+    var replayer = Replayer{ .ctx = &ctx, .reader = reader };
+    ctx.setAllCallbacks(.{ .function = Replayer.onCall, .payload = &replayer });
+
+    var result = Result{};
+
+    while (try replayer.reader.next()) |event| {
+        switch (event) {
+            .step => |dialogue_id| {
+                _ = ctx.step(replayer.checkDialogueId(dialogue_id) catch break);
+                result.steps += 1;
+                // skip the recorded events of the step, which the context recorded again
+                while (try replayer.reader.next()) |step_event| if (step_event == .result) break;
+            },
+            else => replayer.applyInput(event) catch break,
+        }
+
+        // compare as we go, so that replaying stops at the first divergence
+        recorder.flush();
+        if (comparer.diverged_at != null) break;
+    }
+
+    recorder.flush();
+    result.diverged_at = comparer.diverged_at orelse
+        if (comparer.offset != trace_bytes.len) @min(comparer.offset, replayer.reader.pos) else null;
+
+    return result;
+}
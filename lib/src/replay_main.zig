@@ -0,0 +1,100 @@
+//! alternis-replay: re-run recorded traces against a dialogue, at full speed and headless.
+//! Exits with a non-zero status if the dialogue no longer steps the way it did when recorded,
+//! so traces from production can be used as regression tests and as benchmarks.
+
+const std = @import("std");
+const FileBuffer = @import("./FileBuffer.zig");
+const DialogueContext = @import("./main.zig").DialogueContext;
+const replay = @import("./replay.zig").replay;
+
+const usage =
+    \\usage: alternis-replay [--repeat N] <dialogue.alternis.json> <trace>...
+    \\
+    \\Replays each trace against the dialogue, reporting the first divergence and the speed.
+    \\  --repeat N  replay each trace N times, for benchmarking
+    \\
+;
+
+pub fn main() !u8 {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const alloc = gpa.allocator();
+
+    const args = try std.process.argsAlloc(alloc);
+    defer std.process.argsFree(alloc, args);
+
+    const stdout = std.io.getStdOut().writer();
+    const stderr = std.io.getStdErr().writer();
+
+    var repeat: usize = 1;
+    var positionals = std.ArrayList([]const u8).init(alloc);
+    defer positionals.deinit();
+
+    var arg_index: usize = 1;
+    while (arg_index < args.len) : (arg_index += 1) {
+        const arg = args[arg_index];
+        if (std.mem.eql(u8, arg, "--repeat")) {
+            arg_index += 1;
+            if (arg_index >= args.len) {
+                try stderr.writeAll(usage);
+                return 2;
+            }
+            repeat = std.fmt.parseInt(usize, args[arg_index], 10) catch {
+                try stderr.print("invalid repeat count '{s}'\n", .{args[arg_index]});
+                return 2;
+            };
+        } else if (std.mem.eql(u8, arg, "--help") or std.mem.eql(u8, arg, "-h")) {
+            try stdout.writeAll(usage);
+            return 0;
+        } else {
+            try positionals.append(arg);
+        }
+    }
+
+    if (positionals.items.len < 2) {
+        try stderr.writeAll(usage);
+        return 2;
+    }
+
+    const dialogue = try FileBuffer.fromDirAndPath(alloc, std.fs.cwd(), positionals.items[0]);
+    defer dialogue.free(alloc);
+
+    var any_diverged = false;
+
+    for (positionals.items[1..]) |trace_path| {
+        const trace_bytes = try std.fs.cwd().readFileAlloc(alloc, trace_path, std.math.maxInt(usize));
+        defer alloc.free(trace_bytes);
+
+        var total_steps: usize = 0;
+        var timer = try std.time.Timer.start();
+
+        for (0..repeat) |_| {
+            var diagnostic = DialogueContext.Diagnostic{};
+            defer diagnostic.free(alloc);
+
+            const result = replay(alloc, dialogue.buffer, trace_bytes, &diagnostic) catch |e| {
+                try stderr.print("{s}: {}: {s}\n", .{ trace_path, e, diagnostic.error_message.toZig() });
+                return 1;
+            };
+
+            total_steps += result.steps;
+
+            if (result.diverged_at) |offset| {
+                try stdout.print("{s}: diverged at byte {} after {} steps\n", .{ trace_path, offset, result.steps });
+                any_diverged = true;
+                break;
+            }
+        } else {
+            const elapsed_ns = timer.read();
+            const steps_per_second = @as(f64, @floatFromInt(total_steps)) / (@as(f64, @floatFromInt(@max(elapsed_ns, 1))) / std.time.ns_per_s);
+            try stdout.print("{s}: ok, {} steps in {d:.3}ms ({d:.0} steps/s)\n", .{
+                trace_path,
+                total_steps,
+                @as(f64, @floatFromInt(elapsed_ns)) / std.time.ns_per_ms,
+                steps_per_second,
+            });
+        }
+    }
+
+    return if (any_diverged) 1 else 0;
+}
@@ -71,3 +71,165 @@ pub const ConfigurableSimpleAlloc = struct {
         self.free(buf.ptr);
     }
 };
+
+/// allocation functions provided by the host, which all receive the host's user pointer.
+/// Used to give each context its own heap, unlike the process wide ConfigurableSimpleAlloc
+pub const AllocatorCallbacks = extern struct {
+    malloc: *const fn (len: usize, user: ?*anyopaque) callconv(.C) ?*anyopaque,
+    /// optional, grow or shrink an allocation *in place*, returning `ptr` on success,
+    /// or null (leaving the allocation untouched) if it would have to move.
+    /// Called for every resize, so `old_len` is always the length the block was last allocated or resized to.
+    /// NOTE: a moving realloc can't be used here, since on failure the engine copies from the old allocation itself
+    resize: ?*const fn (ptr: ?*anyopaque, old_len: usize, new_len: usize, user: ?*anyopaque) callconv(.C) ?*anyopaque = null,
+    free: *const fn (ptr: ?*anyopaque, user: ?*anyopaque) callconv(.C) void,
+    user: ?*anyopaque = null,
+};
+
+/// a zig allocator using AllocatorCallbacks
+pub const CallbacksAlloc = struct {
+    callbacks: AllocatorCallbacks,
+
+    pub fn init(callbacks: AllocatorCallbacks) @This() {
+        return .{ .callbacks = callbacks };
+    }
+
+    pub fn allocator(self: *@This()) std.mem.Allocator {
+        return std.mem.Allocator{
+            .ptr = self,
+            .vtable = &vtable,
+        };
+    }
+
+    const vtable = std.mem.Allocator.VTable{
+        .alloc = _alloc,
+        .resize = _resize,
+        .free = _free,
+    };
+
+    fn _alloc(
+        _self: *anyopaque,
+        len: usize,
+        log2_ptr_align: u8,
+        ret_addr: usize,
+    ) ?[*]u8 {
+        const self: *CallbacksAlloc = @alignCast(@ptrCast(_self));
+        _ = ret_addr;
+        // see ConfigurableSimpleAlloc._alloc
+        std.debug.assert(log2_ptr_align <= comptime std.math.log2_int(usize, @alignOf(std.c.max_align_t)));
+        return @as(?[*]u8, @ptrCast(self.callbacks.malloc(len, self.callbacks.user)));
+    }
+
+    fn _resize(
+        _self: *anyopaque,
+        buf: []u8,
+        log2_old_align: u8,
+        new_len: usize,
+        ret_addr: usize,
+    ) bool {
+        const self: *CallbacksAlloc = @alignCast(@ptrCast(_self));
+        _ = log2_old_align;
+        _ = ret_addr;
+        // without the callback, a shrunk block is still freed whole
+        const resize = self.callbacks.resize orelse return new_len <= buf.len;
+        return resize(buf.ptr, buf.len, new_len, self.callbacks.user) != null;
+    }
+
+    fn _free(
+        _self: *anyopaque,
+        buf: []u8,
+        log2_old_align: u8,
+        ret_addr: usize,
+    ) void {
+        const self: *CallbacksAlloc = @alignCast(@ptrCast(_self));
+        _ = log2_old_align;
+        _ = ret_addr;
+        self.callbacks.free(buf.ptr, self.callbacks.user);
+    }
+};
+
+const t = std.testing;
+
+/// a bump allocator over a fixed buffer, which can only grow its last allocation in place
+const TestHeap = struct {
+    buffer: [256]u8 align(16) = undefined,
+    end: usize = 0,
+    last: ?[*]u8 = null,
+    resize_calls: usize = 0,
+    frees: usize = 0,
+
+    fn malloc(len: usize, user: ?*anyopaque) callconv(.C) ?*anyopaque {
+        const self: *@This() = @alignCast(@ptrCast(user.?));
+        const start = std.mem.alignForward(usize, self.end, 16);
+        if (start + len > self.buffer.len) return null;
+        self.end = start + len;
+        self.last = self.buffer[start..].ptr;
+        return self.last;
+    }
+
+    fn resize(ptr: ?*anyopaque, old_len: usize, new_len: usize, user: ?*anyopaque) callconv(.C) ?*anyopaque {
+        const self: *@This() = @alignCast(@ptrCast(user.?));
+        self.resize_calls += 1;
+        if (@as(?[*]u8, @ptrCast(ptr)) != self.last or self.end - old_len + new_len > self.buffer.len) return null;
+        self.end = self.end - old_len + new_len;
+        return ptr;
+    }
+
+    fn free(_: ?*anyopaque, user: ?*anyopaque) callconv(.C) void {
+        const self: *@This() = @alignCast(@ptrCast(user.?));
+        self.frees += 1;
+    }
+};
+
+test "callbacks alloc grows in place when the resize callback succeeds" {
+    var heap = TestHeap{};
+    var callbacks_alloc = CallbacksAlloc.init(.{
+        .malloc = TestHeap.malloc,
+        .resize = TestHeap.resize,
+        .free = TestHeap.free,
+        .user = &heap,
+    });
+    const alloc = callbacks_alloc.allocator();
+
+    const buf = try alloc.alloc(u8, 16);
+    try t.expect(alloc.resize(buf, 64));
+    try t.expectEqual(@as(usize, 1), heap.resize_calls);
+    try t.expectEqual(@as(usize, 64), heap.end);
+
+    // shrinks go through the callback too, so the host's length stays the engine's
+    try t.expect(alloc.resize(buf.ptr[0..64], 8));
+    try t.expectEqual(@as(usize, 2), heap.resize_calls);
+    try t.expectEqual(@as(usize, 8), heap.end);
+    try t.expect(alloc.resize(buf.ptr[0..8], 32));
+    try t.expectEqual(@as(usize, 32), heap.end);
+
+    alloc.free(buf.ptr[0..32]);
+    try t.expectEqual(@as(usize, 1), heap.frees);
+}
+
+test "callbacks alloc moves when the resize callback refuses" {
+    var heap = TestHeap{};
+    var callbacks_alloc = CallbacksAlloc.init(.{
+        .malloc = TestHeap.malloc,
+        .resize = TestHeap.resize,
+        .free = TestHeap.free,
+        .user = &heap,
+    });
+    const alloc = callbacks_alloc.allocator();
+
+    const first = try alloc.alloc(u8, 16);
+    @memcpy(first, "sixteen bytes!!!");
+    // no longer the last allocation, so it can't grow in place
+    const second = try alloc.alloc(u8, 16);
+    try t.expect(!alloc.resize(first, 32));
+    try t.expectEqual(@as(usize, 1), heap.resize_calls);
+
+    // realloc falls back to copying into a new allocation and freeing the old one
+    const grown = try alloc.realloc(first, 32);
+    try t.expect(grown.ptr != first.ptr);
+    try t.expectEqualStrings("sixteen bytes!!!", grown[0..16]);
+    try t.expectEqual(@as(usize, 1), heap.frees);
+
+    alloc.free(grown);
+    alloc.free(second);
+    try t.expectEqual(@as(usize, 3), heap.frees);
+}
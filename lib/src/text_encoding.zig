@@ -0,0 +1,36 @@
+//! utilities for converting the utf8 text of a dialogue to the output encoding requested by the host
+
+const std = @import("std");
+
+/// The encoding of the strings in step results
+pub const TextEncoding = enum(u8) {
+    utf8 = 0,
+    /// little endian utf16, for hosts which store text as utf16 (e.g. Unreal's TCHAR).
+    /// The strings are still passed as byte slices, so their length is in bytes, not code units
+    utf16 = 1,
+};
+
+/// transcode utf8 text to utf16 little endian, returning the bytes of the utf16 buffer.
+/// The buffer is allocated as u16s, so it is aligned for the host to read it as such
+pub fn utf8ToUtf16LeBytes(alloc: std.mem.Allocator, utf8: []const u8) ![]const u8 {
+    const utf16 = try alloc.alloc(u16, try std.unicode.calcUtf16LeLen(utf8));
+    errdefer alloc.free(utf16);
+    _ = try std.unicode.utf8ToUtf16Le(utf16, utf8);
+    return std.mem.sliceAsBytes(utf16);
+}
+
+/// transcode utf8 text to the given encoding.
+/// NOTE: for utf8, the input is returned as is, so the result is only owned by the caller
+/// if the encoding is not utf8
+pub fn encode(alloc: std.mem.Allocator, utf8: []const u8, encoding: TextEncoding) ![]const u8 {
+    return switch (encoding) {
+        .utf8 => utf8,
+        .utf16 => try utf8ToUtf16LeBytes(alloc, utf8),
+    };
+}
+
+test "utf8 to utf16 bytes" {
+    const actual = try utf8ToUtf16LeBytes(std.testing.allocator, "hé€");
+    defer std.testing.allocator.free(@as([]const u16, @alignCast(std.mem.bytesAsSlice(u16, actual))));
+    try std.testing.expectEqualSlices(u8, &.{ 'h', 0, 0xe9, 0, 0xac, 0x20 }, actual);
+}
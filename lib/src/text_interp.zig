@@ -6,7 +6,8 @@ const ChunkWriter = @import("./ChunkWriter.zig").ChunkWriter;
 // dialogues are unlikely to have very long text
 const SmallChunkWriter = ChunkWriter(512);
 
-pub fn interpolate_template(template: []const u8, alloc: std.mem.Allocator, vars: *std.StringHashMap([]const u8)) ![]u8 {
+/// `vars` is anything with a `get(name: []const u8) ?[]const u8` method, e.g. a *std.StringHashMap([]const u8)
+pub fn interpolate_template(template: []const u8, alloc: std.mem.Allocator, vars: anytype) ![]u8 {
     // FIXME: would be nicer if the writer were an argument
     var chunk_writer = try SmallChunkWriter.init(alloc);
     defer chunk_writer.deinit();
@@ -0,0 +1,239 @@
+//! A compact binary trace of everything that determines how a context steps: which dialogue
+//! was stepped, the nodes it visited, its random draws, the step results, and the host's
+//! inputs (replies, resets, variable writes, restored random draws). Replaying the inputs of a trace against the
+//! same dialogue reproduces it exactly, so a trace doubles as a regression test and a benchmark.
+//! @see replay_main.zig
+//!
+//! The format is the header "ADTR", a version byte and the seed as ULEB128,
+//! then events, each a tag byte followed by its fields, integers as ULEB128 and strings
+//! as a ULEB128 length followed by the bytes.
+//! NOTE: writes to a shared WorldState by the host are not part of the trace
+
+const std = @import("std");
+const usz = @import("./config.zig").usz;
+
+pub const magic = "ADTR";
+/// 2: random switches draw from a counter-based stream per dialogue, whose draw count the host may restore
+pub const version: u8 = 2;
+
+/// receives the bytes of the trace as the buffer fills, e.g. to append them to a file
+pub const Sink = extern struct {
+    write: *const fn (user: ?*anyopaque, ptr: [*]const u8, len: usize) callconv(.C) void,
+    user: ?*anyopaque = null,
+};
+
+pub const EventTag = enum(u8) {
+    step = 1,
+    node = 2,
+    random = 3,
+    result = 4,
+    reply = 5,
+    reset = 6,
+    set_boolean = 7,
+    set_string = 8,
+    set_random_draws = 9,
+};
+
+pub const Event = union(EventTag) {
+    /// step was called for this dialogue id
+    step: usz,
+    /// the index of a node visited during a step
+    node: usz,
+    /// the bits of a random switch's draw
+    random: u32,
+    /// a step returned, options has the amount of available options
+    result: struct { tag: u8, options: usz = 0 },
+    reply: struct { dialogue_id: usz, reply_index: usz },
+    reset: struct { dialogue_id: usz, node_index: usz },
+    set_boolean: struct { var_index: usz, value: bool },
+    set_string: struct { name: []const u8, value: []const u8 },
+    /// the host continued a dialogue's random stream from a draw count, e.g. when loading a save
+    set_random_draws: struct { dialogue_id: usz, draws: u64 },
+
+    /// whether the event is an input from the host, rather than a product of stepping
+    pub fn isInput(self: @This()) bool {
+        return switch (self) {
+            .reply, .reset, .set_boolean, .set_string, .set_random_draws => true,
+            else => false,
+        };
+    }
+};
+
+/// buffers encoded events and hands them to the sink whenever the buffer is full.
+/// Recording never fails and never allocates
+pub const Recorder = struct {
+    buffer: []u8,
+    len: usize = 0,
+    sink: Sink,
+
+    const Writer = std.io.GenericWriter(*Recorder, error{}, writeFn);
+
+    /// the buffer must outlive the recorder, larger buffers mean fewer calls to the sink
+    pub fn init(buffer: []u8, sink: Sink) @This() {
+        std.debug.assert(buffer.len > 0);
+        return .{ .buffer = buffer, .sink = sink };
+    }
+
+    /// write the header, must be called once before recording any events
+    pub fn begin(self: *@This(), seed: u64) void {
+        const w = self.writer();
+        w.writeAll(magic) catch unreachable;
+        w.writeByte(version) catch unreachable;
+        std.leb.writeULEB128(w, seed) catch unreachable;
+    }
+
+    pub fn record(self: *@This(), event: Event) void {
+        const w = self.writer();
+        w.writeByte(@intFromEnum(event)) catch unreachable;
+        switch (event) {
+            .step, .node => |v| std.leb.writeULEB128(w, v) catch unreachable,
+            .random => |v| std.leb.writeULEB128(w, v) catch unreachable,
+            .result => |v| {
+                w.writeByte(v.tag) catch unreachable;
+                std.leb.writeULEB128(w, v.options) catch unreachable;
+            },
+            .reply => |v| {
+                std.leb.writeULEB128(w, v.dialogue_id) catch unreachable;
+                std.leb.writeULEB128(w, v.reply_index) catch unreachable;
+            },
+            .reset => |v| {
+                std.leb.writeULEB128(w, v.dialogue_id) catch unreachable;
+                std.leb.writeULEB128(w, v.node_index) catch unreachable;
+            },
+            .set_boolean => |v| {
+                std.leb.writeULEB128(w, v.var_index) catch unreachable;
+                w.writeByte(@intFromBool(v.value)) catch unreachable;
+            },
+            .set_string => |v| {
+                std.leb.writeULEB128(w, v.name.len) catch unreachable;
+                w.writeAll(v.name) catch unreachable;
+                std.leb.writeULEB128(w, v.value.len) catch unreachable;
+                w.writeAll(v.value) catch unreachable;
+            },
+            .set_random_draws => |v| {
+                std.leb.writeULEB128(w, v.dialogue_id) catch unreachable;
+                std.leb.writeULEB128(w, v.draws) catch unreachable;
+            },
+        }
+    }
+
+    /// hand any buffered bytes to the sink
+    pub fn flush(self: *@This()) void {
+        if (self.len == 0) return;
+        self.sink.write(self.sink.user, self.buffer.ptr, self.len);
+        self.len = 0;
+    }
+
+    fn writer(self: *@This()) Writer {
+        return .{ .context = self };
+    }
+
+    fn writeFn(self: *@This(), bytes: []const u8) error{}!usize {
+        var remaining = bytes;
+        while (remaining.len > 0) {
+            if (self.len == self.buffer.len) self.flush();
+            const copy_len = @min(remaining.len, self.buffer.len - self.len);
+            @memcpy(self.buffer[self.len..][0..copy_len], remaining[0..copy_len]);
+            self.len += copy_len;
+            remaining = remaining[copy_len..];
+        }
+        return bytes.len;
+    }
+};
+
+pub const ReadError = error{ NotATrace, UnsupportedTraceVersion, InvalidTraceEvent, EndOfStream, Overflow };
+
+/// decodes a complete trace in memory, strings in events point into it
+pub const Reader = struct {
+    bytes: []const u8,
+    pos: usize = 0,
+
+    /// reads the header, returning the seed
+    pub fn init(bytes: []const u8) ReadError!struct { Reader, u64 } {
+        var self = Reader{ .bytes = bytes };
+        if (!std.mem.startsWith(u8, bytes, magic)) return error.NotATrace;
+        self.pos = magic.len;
+        if (try self.readByte() != version) return error.UnsupportedTraceVersion;
+        const seed = try self.readInt(u64);
+        return .{ self, seed };
+    }
+
+    /// the next event without consuming it, null at the end of the trace
+    pub fn peek(self: *const @This()) ReadError!?Event {
+        var copy = self.*;
+        return copy.next();
+    }
+
+    /// null at the end of the trace
+    pub fn next(self: *@This()) ReadError!?Event {
+        if (self.pos == self.bytes.len) return null;
+        const tag = std.meta.intToEnum(EventTag, try self.readByte()) catch return error.InvalidTraceEvent;
+        return switch (tag) {
+            .step => .{ .step = try self.readInt(usz) },
+            .node => .{ .node = try self.readInt(usz) },
+            .random => .{ .random = try self.readInt(u32) },
+            .result => .{ .result = .{ .tag = try self.readByte(), .options = try self.readInt(usz) } },
+            .reply => .{ .reply = .{ .dialogue_id = try self.readInt(usz), .reply_index = try self.readInt(usz) } },
+            .reset => .{ .reset = .{ .dialogue_id = try self.readInt(usz), .node_index = try self.readInt(usz) } },
+            .set_boolean => .{ .set_boolean = .{ .var_index = try self.readInt(usz), .value = try self.readByte() != 0 } },
+            .set_string => .{ .set_string = .{ .name = try self.readString(), .value = try self.readString() } },
+            .set_random_draws => .{ .set_random_draws = .{ .dialogue_id = try self.readInt(usz), .draws = try self.readInt(u64) } },
+        };
+    }
+
+    fn readByte(self: *@This()) ReadError!u8 {
+        if (self.pos >= self.bytes.len) return error.EndOfStream;
+        defer self.pos += 1;
+        return self.bytes[self.pos];
+    }
+
+    fn readInt(self: *@This(), comptime T: type) ReadError!T {
+        var stream = std.io.fixedBufferStream(self.bytes[self.pos..]);
+        const value = try std.leb.readULEB128(T, stream.reader());
+        self.pos += stream.pos;
+        return value;
+    }
+
+    fn readString(self: *@This()) ReadError![]const u8 {
+        const len = try self.readInt(usize);
+        if (len > self.bytes.len - self.pos) return error.EndOfStream;
+        defer self.pos += len;
+        return self.bytes[self.pos..][0..len];
+    }
+};
+
+test "trace round trip" {
+    const Collect = struct {
+        fn write(user: ?*anyopaque, ptr: [*]const u8, len: usize) callconv(.C) void {
+            const list: *std.ArrayList(u8) = @alignCast(@ptrCast(user.?));
+            list.appendSlice(ptr[0..len]) catch unreachable;
+        }
+    };
+
+    var collected = std.ArrayList(u8).init(std.testing.allocator);
+    defer collected.deinit();
+
+    // a small buffer so that events straddle flushes
+    var buffer: [5]u8 = undefined;
+    var recorder = Recorder.init(&buffer, .{ .write = Collect.write, .user = &collected });
+
+    const events = [_]Event{
+        .{ .step = 0 },
+        .{ .node = 300 },
+        .{ .random = 0x3f000000 },
+        .{ .result = .{ .tag = 1, .options = 2 } },
+        .{ .reply = .{ .dialogue_id = 0, .reply_index = 1 } },
+        .{ .set_boolean = .{ .var_index = 2, .value = true } },
+        .{ .set_string = .{ .name = "name", .value = "Testy McTester" } },
+        .{ .set_random_draws = .{ .dialogue_id = 1, .draws = 1 << 40 } },
+    };
+
+    recorder.begin(1234);
+    for (events) |event| recorder.record(event);
+    recorder.flush();
+
+    var reader, const seed = try Reader.init(collected.items);
+    try std.testing.expectEqual(@as(u64, 1234), seed);
+    for (events) |expected| try std.testing.expectEqualDeep(@as(?Event, expected), try reader.next());
+    try std.testing.expectEqual(@as(?Event, null), try reader.next());
+}
@@ -0,0 +1,169 @@
+// compiled and run by `zig build test`, from the lib directory
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#include "alternis.hpp"
+
+#define EXPECT(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #cond); \
+            std::exit(1); \
+        } \
+    } while (0)
+
+static std::string read_file(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    EXPECT(file.good());
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+static_assert(!std::is_copy_constructible_v<alternis::Context>, "Context must not be copyable");
+static_assert(std::is_nothrow_move_constructible_v<alternis::Context>, "Context must be movable");
+
+static void test_bad_json() {
+    alternis::Error error;
+    alternis::Context ctx = alternis::Context::from_json("{}", {}, &error);
+    EXPECT(!ctx);
+    EXPECT(error.code != NoError);
+    EXPECT(!error.message.empty());
+}
+
+static void test_step_simple() {
+    const std::string json = read_file("./test/assets/simple1.alternis.json");
+    alternis::Error error;
+    alternis::Context ctx = alternis::Context::from_json(json, {}, &error);
+    if (!ctx) std::fprintf(stderr, "err code %d: '%s'\n", error.code, error.message.c_str());
+    EXPECT(ctx);
+
+    const char* const texts[] = { "hello world!", "goodbye cruel world!" };
+    for (const char* text : texts) {
+        alternis::Step step = ctx.step(0);
+        EXPECT(step.tag() == alternis::Step::Tag::line);
+        EXPECT(step.line().speaker() == "test");
+        EXPECT(step.line().text() == text);
+    }
+
+    EXPECT(ctx.step(0).is_done());
+
+    // a line view outlives the temporary step it came from
+    ctx.reset(0);
+    alternis::LineView kept = ctx.step(0).line();
+    EXPECT(kept.speaker() == "test");
+    EXPECT(kept.text() == "hello world!");
+
+    // moving hands over the context, which is destroyed only once
+    alternis::Context moved = std::move(ctx);
+    EXPECT(!ctx);
+    moved.reset(0);
+    EXPECT(moved.step(0).line().text() == "hello world!");
+}
+
+static void test_visit_and_batches() {
+    const std::string json = read_file("./test/assets/sample1.alternis.json");
+    alternis::Context ctx = alternis::Context::from_json(json);
+    EXPECT(ctx);
+
+    ::Line buffer[8];
+
+    // follows the random switch to the branch its next draw takes, and stops at the call
+    alternis::LineSpan peeked = ctx.peek(0, buffer);
+    EXPECT(peeked.size() == 3);
+    EXPECT(peeked[0].text() == "Hey");
+    // seed 0 draws 0.34 first, past the 1 in 10 chance of the first branch
+    EXPECT(peeked[1].text() == "Yo");
+
+    alternis::Advance advanced = ctx.advance(0, buffer);
+    EXPECT(advanced.end.tag() == alternis::Step::Tag::function_called);
+    // the random switch drew once
+    EXPECT(ctx.random_draws(0) == 1);
+
+    const char* const texts[] = { "Hey", "Yo", "What's your name?" };
+    EXPECT(advanced.lines.size() == 3);
+    size_t i = 0;
+    for (alternis::LineView line : advanced.lines) EXPECT(line.text() == texts[i++]);
+
+    {
+        // the 7th draw of seed 0 (0.09) lands on the first branch instead
+        alternis::Context other = ctx.share();
+        other.set_random_draws(0, 6);
+        alternis::Advance other_advanced = other.advance(0, buffer);
+        EXPECT(other_advanced.lines.size() == 3);
+        EXPECT(other_advanced.lines[1].text() == "WELL HELLO");
+        EXPECT(other.random_draws(0) == 7);
+    }
+
+    struct Visitor {
+        size_t operator()(alternis::Done) const { return 0; }
+        size_t operator()(alternis::FunctionCalled) const { return 0; }
+        size_t operator()(alternis::LineView) const { return 0; }
+        size_t operator()(const alternis::Options& options) const {
+            EXPECT(options.texts.size() == options.ids.size());
+            for (alternis::LineView text : options.texts) EXPECT(!text.text().empty());
+            return options.size();
+        }
+    };
+
+    alternis::Step step = ctx.step(0);
+    EXPECT(step.visit(Visitor{}) == 2);
+
+    ctx.reply(0, step.options().ids[1]);
+    alternis::Step after_reply = ctx.step(0);
+    EXPECT(after_reply.line().text() == "Ok. What was your name again?");
+    EXPECT(!after_reply.line().has_metadata() || after_reply.line().metadata().size() > 0);
+
+    const uint64_t seq = ctx.latest_change_seq();
+    ctx.set_string("name", "Testy");
+    ctx.set_boolean("Aaron likes you", true);
+    EXPECT(ctx.get_string("name") == "Testy");
+    EXPECT(ctx.get_boolean("Aaron likes you"));
+
+    VariableChange changes[4];
+    bool missed = true;
+    alternis::span<const VariableChange> changed = ctx.changes_since(seq, changes, &missed);
+    EXPECT(!missed);
+    EXPECT(changed.size() == 2);
+    EXPECT(ctx.variable_name(VARIABLE_TYPE_STRING, changed[0].index) == "name");
+    EXPECT(alternis::view(changed[0].new_string) == "Testy");
+    EXPECT(changed[1].type == VARIABLE_TYPE_BOOLEAN && changed[1].new_boolean);
+
+    usz dirty[4];
+    EXPECT(ctx.take_dirty_variables(VARIABLE_TYPE_STRING, dirty).size() == 1);
+    EXPECT(ctx.take_dirty_variables(VARIABLE_TYPE_STRING, dirty).empty());
+    const MemoryReport report = ctx.memory_report();
+    EXPECT(report.nodes > 0);
+}
+
+static void test_compressed_text() {
+    const std::string json = read_file("./test/assets/sample1.alternis.json");
+    DialogueContextCreateOpts opts{};
+    opts.compress_text = true;
+    alternis::Context ctx = alternis::Context::from_json(json, opts);
+    EXPECT(ctx);
+
+    ::Line buffer[8];
+    alternis::Advance advanced = ctx.advance(0, buffer);
+    EXPECT(advanced.lines.size() == 3);
+    EXPECT(advanced.lines[1].speaker() == "Aaron");
+    EXPECT(advanced.lines[2].text() == "What's your name?");
+
+    ctx.set_string("name", "Testy");
+    alternis::Step step = ctx.step(0);
+    EXPECT(step.options().texts[1].text() == "It's Testy");
+}
+
+int main() {
+    ade_set_alloc(std::malloc, std::free);
+    test_bad_json();
+    test_step_simple();
+    test_visit_and_batches();
+    test_compressed_text();
+    std::puts("alternis.hpp tests passed");
+    return 0;
+}
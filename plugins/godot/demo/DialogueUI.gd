@@ -6,6 +6,9 @@ func _ready():
   $Center/VBox/StartButton.pressed.connect(_on_start_button_pressed)
   $Center/VBox/HBox/NextButton.pressed.connect(_on_next_button_pressed)
   $AlternisDialogue.function_called.connect(_on_dialogue_function_called)
+  # the dialogue compiles in the background, it can't be stepped until it is loaded
+  $Center/VBox/StartButton.disabled = not $AlternisDialogue.is_loaded()
+  $AlternisDialogue.loaded.connect(func(_dialogue): $Center/VBox/StartButton.disabled = false)
 
 func _on_dialogue_function_called(dialogue: Node, function: String):
   match function:
@@ -1,7 +1,8 @@
 #include "AlternisDialogue.h"
-#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/resource_loader.hpp>
 #include <godot_cpp/core/memory.hpp>
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/error_macros.hpp>
 #include <godot_cpp/variant/string.hpp>
 #include <godot_cpp/variant/dictionary.hpp>
 #include <godot_cpp/variant/array.hpp>
@@ -41,6 +42,11 @@ void AlternisDialogue::_bind_methods() {
                           PropertyInfo(Variant::OBJECT, "self"),
                           PropertyInfo(Variant::STRING, "name")));
 
+    // the dialogue can be stepped, variables and callbacks set before were applied
+    ADD_SIGNAL(MethodInfo("loaded", PropertyInfo(Variant::OBJECT, "self")));
+
+    ClassDB::bind_method(D_METHOD("is_loaded"), &AlternisDialogue::is_loaded);
+
     ClassDB::bind_method(D_METHOD("reset"), &AlternisDialogue::reset);
     ClassDB::bind_method(D_METHOD("reply", "replyId"), &AlternisDialogue::reply);
     ClassDB::bind_method(D_METHOD("step"), &AlternisDialogue::step);
@@ -48,23 +54,18 @@ void AlternisDialogue::_bind_methods() {
     ClassDB::bind_method(D_METHOD("set_variable_string"), &AlternisDialogue::set_variable_string);
     ClassDB::bind_method(D_METHOD("set_variable_boolean"), &AlternisDialogue::set_variable_boolean);
     ClassDB::bind_method(D_METHOD("set_callback"), &AlternisDialogue::set_callback);
+
+    ClassDB::bind_method(D_METHOD("_on_resource_compiled", "resource"), &AlternisDialogue::_on_resource_compiled);
 }
 
 AlternisDialogue::AlternisDialogue()
-    : ade_ctx(nullptr)
-    , resource_path("")
+    : resource_path("")
     , random_seed(0)
     , interpolate(true)
 {
-    ade_set_alloc(
-        (void*(*)(size_t)) ::godot::Memory::alloc_static,
-        (void(*)(void*)) ::godot::Memory::free_static
-    );
 }
 
 AlternisDialogue::~AlternisDialogue() {
-    if (this->ade_ctx != nullptr) ade_dialogue_ctx_destroy(ade_ctx);
-
     auto* cb_info = this->first_callback;
     while (cb_info != nullptr) {
         auto* next = cb_info->next;
@@ -80,112 +81,127 @@ static void _dispatch_callback(void* in_cb_info) {
 }
 
 void AlternisDialogue::_ready() {
-    // FIXME: check, is this like reference count destroyed?
-    auto json_bytes = godot::FileAccess::get_file_as_bytes(this->resource_path);
-
     random_seed = this->random_seed == 0 ? random() : this->random_seed;
 
-    const char* errPtr = nullptr;
+    // cached by path, so every node using the same file shares one compiled dialogue
+    this->dialogue_resource = ResourceLoader::get_singleton()->load(this->resource_path, "AlternisDialogueResource");
 
-    this->ade_ctx = ade_dialogue_ctx_create_json(
-        reinterpret_cast<const char*>(json_bytes.ptr()),
-        json_bytes.size(),
-        random_seed,
-        !this->interpolate,
-        &errPtr
-    );
+    if (this->dialogue_resource.is_null()) {
+        fprintf(stderr, "alternis: failed to load '%s'", resource_path.utf8().get_data());
+        return;
+    }
 
-    if (errPtr != nullptr) {
-        // FIXME: need to free the error
-        fprintf(stderr, "alternis: init error '%s'", resource_path.utf8().get_data());
+    if (this->dialogue_resource->is_compiled()) {
+        this->_init_context();
+    } else {
+        this->dialogue_resource->connect("compiled",
+                                         Callable(this, "_on_resource_compiled"),
+                                         Object::CONNECT_ONE_SHOT);
     }
+}
+
+void AlternisDialogue::_on_resource_compiled(Object* resource) {
+    this->_init_context();
+}
 
-    if (this->ade_ctx == nullptr) {
+// applies everything that was set before the context finished loading
+void AlternisDialogue::_init_context() {
+    this->ade_ctx = Context(this->dialogue_resource->create_context(this->random_seed, this->interpolate));
+
+    if (!this->ade_ctx) {
         fprintf(stderr, "alternis: got invalid context");
         return;
     }
 
-    ade_dialogue_ctx_set_all_callbacks(this->ade_ctx, [](SetAllCallbacksPayload* payload){
+    this->ade_ctx.set_all_callbacks([](SetAllCallbacksPayload* payload){
         auto* _this = static_cast<AlternisDialogue*>(payload->inner_payload);
        _this->emit_signal("function_called", _this, godot::String::utf8(payload->name.ptr, payload->name.len));
     }, this);
+
+    const Array boolean_names = this->pending_booleans.keys();
+    for (int64_t i = 0; i < boolean_names.size(); ++i)
+        this->set_variable_boolean(boolean_names[i], this->pending_booleans[boolean_names[i]]);
+    this->pending_booleans.clear();
+
+    const Array string_names = this->pending_strings.keys();
+    for (int64_t i = 0; i < string_names.size(); ++i)
+        this->set_variable_string(string_names[i], this->pending_strings[string_names[i]]);
+    this->pending_strings.clear();
+
+    for (auto* cb_info = this->first_callback; cb_info != nullptr; cb_info = cb_info->next)
+        this->_register_callback(cb_info);
+
+    emit_signal("loaded", this);
+}
+
+bool AlternisDialogue::is_loaded() const {
+    return static_cast<bool>(this->ade_ctx);
 }
 
-static Dictionary stepResultToDict(StepResult stepResult) {
+static Dictionary lineToDict(LineView line) {
     Dictionary result;
-    if (stepResult.tag == STEP_RESULT_DONE) {
+    result["speaker"] = String::utf8(line.speaker().data(), line.speaker().size());
+    result["text"] = String::utf8(line.text().data(), line.text().size());
+    if (line.has_metadata())
+        result["metadata"] = String::utf8(line.metadata().data(), line.metadata().size());
+    return result;
+}
+
+struct StepResultToDict {
+    Dictionary operator()(Done) const {
+        Dictionary result;
         result["done"] = true;
+        return result;
+    }
 
-    } else if (stepResult.tag == STEP_RESULT_OPTIONS) {
+    Dictionary operator()(const Options& options) const {
+        Dictionary result;
         Dictionary subdict;
         result["options"] = subdict;
         Array texts, ids;
         subdict["texts"] = texts;
         subdict["ids"] = ids;
 
-        for (int i = 0; i < stepResult.options.texts.len; ++i) {
-            const auto& line = stepResult.options.texts.ptr[i];
-
-            Dictionary textDict;
-            textDict["speaker"] = String::utf8(line.speaker.ptr, line.speaker.len);
-            textDict["text"] = String::utf8(line.text.ptr, line.text.len);
-            if (line.metadata.ptr != nullptr)
-                textDict["metadata"] = String::utf8(line.metadata.ptr, line.metadata.len);
+        for (LineView text : options.texts) texts.append(lineToDict(text));
+        for (size_t id : options.ids) ids.append(id);
 
-            const auto& id = stepResult.options.ids.ptr[i];
-
-            texts.append(textDict);
-            ids.append(id);
-        }
-
-    } else if (stepResult.tag == STEP_RESULT_LINE) {
-        Dictionary subdict;
-        const auto& line = stepResult.line;
-        subdict["speaker"] = String::utf8(line.speaker.ptr, line.speaker.len);
-        subdict["text"] = String::utf8(line.text.ptr, line.text.len);
-        if (line.metadata.ptr != nullptr)
-            subdict["metadata"] = String::utf8(line.metadata.ptr, line.metadata.len);
+        return result;
+    }
 
-        result["line"] = subdict;
+    Dictionary operator()(LineView line) const {
+        Dictionary result;
+        result["line"] = lineToDict(line);
+        return result;
+    }
 
-    } else if (stepResult.tag == STEP_RESULT_FUNCTION_CALLED) {
+    Dictionary operator()(FunctionCalled) const {
+        Dictionary result;
         result["function_called"] = true;
-
-    } else {
-        // FIXME: not win32 capable
-        fprintf(stderr, "alternis: unreachable, invalid step result tag");
-        abort();
+        return result;
     }
-
-    return result;
-}
+};
 
 Dictionary AlternisDialogue::step() {
     Dictionary result;
 
-    if (this->ade_ctx == nullptr) {
-        // FIXME: how to handle error? Print? ~~abort~~? emit_signal?
-        // LOG_ERROR("dialogue context not set before calling step ()");
-        return result;
-    }
-
-    StepResult nativeResult;
-    ade_dialogue_ctx_step(this->ade_ctx, &nativeResult);
+    ERR_FAIL_COND_V_MSG(!this->ade_ctx, result, "alternis: dialogue stepped before it was loaded, wait for the \"loaded\" signal");
 
-    result = stepResultToDict(nativeResult);
+    // the dictionary copies the strings, which are only valid until the next step
+    result = this->ade_ctx.step(0).visit(StepResultToDict{});
 
     emit_signal("dialogue_stepped", this, result);
     return result;
 }
 
 void AlternisDialogue::reset() {
-    if (this->ade_ctx == nullptr) return;
-    ade_dialogue_ctx_reset(this->ade_ctx);
+    // a context starts at the beginning of the dialogue, so there is nothing to reset before it is loaded
+    if (!this->ade_ctx) return;
+    this->ade_ctx.reset(0);
 }
 
 void AlternisDialogue::reply(size_t replyId) {
-    if (this->ade_ctx == nullptr) return;
-    ade_dialogue_ctx_reply(this->ade_ctx, replyId);
+    ERR_FAIL_COND_MSG(!this->ade_ctx, "alternis: replied before the dialogue was loaded, wait for the \"loaded\" signal");
+    this->ade_ctx.reply(0, replyId);
 }
 
 // FIXME: can this be made void?
@@ -199,30 +215,35 @@ void AlternisDialogue::set_interpolate(const bool value) { this->interpolate = v
 bool AlternisDialogue::get_interpolate() { return this->interpolate; }
 
 void AlternisDialogue::set_variable_string(const godot::StringName name, const godot::String value) {
-    const String name_data{name};
-    ade_dialogue_ctx_set_variable_string(
-        // NOTE: seemingly godot includes the null byte in the size
-        this->ade_ctx, name_data.utf8().get_data(), name_data.utf8().size() - 1,
-        value.utf8().get_data(), value.utf8().size() - 1
+    // applied once loaded
+    if (!this->ade_ctx) {
+        this->pending_strings[name] = value;
+        return;
+    }
+    const CharString name_utf8 = String{name}.utf8();
+    const CharString value_utf8 = value.utf8();
+    this->ade_ctx.set_string(
+        {name_utf8.get_data(), static_cast<size_t>(name_utf8.length())},
+        {value_utf8.get_data(), static_cast<size_t>(value_utf8.length())}
     );
 }
 
 void AlternisDialogue::set_variable_boolean(const godot::StringName name, const bool value) {
-    const String name_data{name};
-    ade_dialogue_ctx_set_variable_boolean(
-        // NOTE: seemingly godot includes the null byte in the size
-        this->ade_ctx, name_data.utf8().get_data(), name_data.utf8().size() - 1,
-        value
-    );
+    // applied once loaded
+    if (!this->ade_ctx) {
+        this->pending_booleans[name] = value;
+        return;
+    }
+    const CharString name_utf8 = String{name}.utf8();
+    this->ade_ctx.set_boolean({name_utf8.get_data(), static_cast<size_t>(name_utf8.length())}, value);
 }
 
 void AlternisDialogue::set_callback(const godot::StringName name, godot::Callable callable) {
-    if (this->ade_ctx == nullptr) return;
-
     auto cb_info = memnew(CallbackInfo);
     *cb_info = CallbackInfo{
         .owner = this,
         .name = name,
+        .name_utf8 = String{name}.utf8(),
         .callable = callable,
     };
 
@@ -230,13 +251,15 @@ void AlternisDialogue::set_callback(const godot::StringName name, godot::Callabl
         this->last_callback->next = cb_info;
     else
         this->first_callback = cb_info;
+    this->last_callback = cb_info;
 
-    // FIXME: isn't this string temporary? doesn't that violate the ade_dialogue_ctx_set_callback API?
-    const String name_data{name};
-    ade_dialogue_ctx_set_callback(
-        // NOTE: seemingly godot includes the null byte in the size
-        this->ade_ctx, name_data.utf8().get_data(), name_data.utf8().size() - 1, _dispatch_callback, cb_info
-    );
+    // registered once loaded otherwise
+    if (this->ade_ctx) this->_register_callback(cb_info);
+}
+
+void AlternisDialogue::_register_callback(CallbackInfo* cb_info) {
+    const CharString& name_utf8 = cb_info->name_utf8;
+    this->ade_ctx.set_callback({name_utf8.get_data(), static_cast<size_t>(name_utf8.length())}, _dispatch_callback, cb_info);
 }
 
 } // namespace alternis
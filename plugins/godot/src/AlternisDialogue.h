@@ -6,7 +6,8 @@
 #include <godot_cpp/variant/string.hpp>
 #include <godot_cpp/variant/string_name.hpp>
 #include <godot_cpp/variant/dictionary.hpp>
-#include <alternis.h>
+#include <alternis.hpp>
+#include "AlternisDialogueResource.h"
 
 namespace alternis {
 
@@ -16,22 +17,36 @@ class AlternisDialogue : public godot::Node {
     struct CallbackInfo {
         AlternisDialogue* owner;
         godot::StringName name;
+        // kept alive for the context, which references the name it was given
+        godot::CharString name_utf8;
         godot::Callable callable;
         CallbackInfo* next = nullptr;
     };
 
     godot::String resource_path;
-    DialogueContext* ade_ctx = nullptr;
+    // shared by all nodes with the same resource_path
+    godot::Ref<AlternisDialogueResource> dialogue_resource;
+    Context ade_ctx;
     // if 0, a random number will be used for the seed
     uint64_t random_seed = 0;
     bool interpolate = true;
 
+    // every callback set, registered with the context once it is loaded
     CallbackInfo* first_callback = nullptr;
     CallbackInfo* last_callback = nullptr;
 
+    // variables set before the context finished loading, applied once it is loaded
+    godot::Dictionary pending_booleans;
+    godot::Dictionary pending_strings;
+
+    void _init_context();
+    void _register_callback(CallbackInfo* cb_info);
+
 protected:
     static void _bind_methods();
 
+    void _on_resource_compiled(godot::Object* resource);
+
 public:
     AlternisDialogue();
     ~AlternisDialogue();
@@ -47,6 +62,9 @@ public:
     void set_interpolate(const bool value);
     bool get_interpolate();
 
+    // whether the context was created, emits the "loaded" signal when it is
+    bool is_loaded() const;
+
     void reset();
     godot::Dictionary step();
     void reply(size_t replyId);
@@ -0,0 +1,133 @@
+#include "AlternisDialogueResource.h"
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/callable.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+
+using namespace godot;
+
+namespace alternis {
+
+void AlternisDialogueResource::_bind_methods() {
+    ClassDB::bind_method(D_METHOD("is_compiled"), &AlternisDialogueResource::is_compiled);
+    ClassDB::bind_method(D_METHOD("get_error_message"), &AlternisDialogueResource::get_error_message);
+    ClassDB::bind_method(D_METHOD("_finish_compile"), &AlternisDialogueResource::_finish_compile);
+
+    ADD_SIGNAL(MethodInfo("compiled", PropertyInfo(Variant::OBJECT, "resource")));
+}
+
+AlternisDialogueResource::AlternisDialogueResource() {}
+
+AlternisDialogueResource::~AlternisDialogueResource() {
+    this->_wait_for_compile();
+    if (this->shared_ctx != nullptr) ade_dialogue_ctx_destroy(this->shared_ctx);
+}
+
+void AlternisDialogueResource::start_compile(const PackedByteArray& bytes) {
+    this->json_bytes = bytes;
+    this->compile_task_id = WorkerThreadPool::get_singleton()->add_task(
+        callable_mp(this, &AlternisDialogueResource::_compile),
+        false,
+        "alternis: compile dialogue"
+    );
+}
+
+// runs on a worker thread, only touches state that the main thread won't until `compiled` is set
+void AlternisDialogueResource::_compile() {
+    Diagnostic diagnostic{};
+
+    // the seed is irrelevant since this context is never stepped
+    this->shared_ctx = ade_dialogue_ctx_create_json(
+        reinterpret_cast<const char*>(this->json_bytes.ptr()),
+        this->json_bytes.size(),
+        1,
+        false,
+        &diagnostic
+    );
+
+    if (this->shared_ctx == nullptr)
+        this->error_message = String::utf8(diagnostic.error_message.ptr, diagnostic.error_message.len);
+
+    ade_diagnostic_destroy(&diagnostic);
+
+    // the context doesn't reference the json after it is created
+    this->json_bytes.clear();
+
+    this->compiled.store(true, std::memory_order_release);
+    this->call_deferred("_finish_compile");
+}
+
+void AlternisDialogueResource::_wait_for_compile() {
+    if (this->compile_task_id == -1) return;
+    WorkerThreadPool::get_singleton()->wait_for_task_completion(this->compile_task_id);
+    this->compile_task_id = -1;
+}
+
+void AlternisDialogueResource::_finish_compile() {
+    this->_wait_for_compile();
+
+    if (this->shared_ctx == nullptr)
+        UtilityFunctions::push_error("alternis: failed to compile '", this->get_path(), "': ", this->error_message);
+
+    emit_signal("compiled", this);
+}
+
+bool AlternisDialogueResource::is_compiled() const {
+    return this->compiled.load(std::memory_order_acquire);
+}
+
+String AlternisDialogueResource::get_error_message() const { return this->error_message; }
+
+DialogueContext* AlternisDialogueResource::create_context(uint64_t random_seed, bool interpolate) const {
+    if (!this->is_compiled() || this->shared_ctx == nullptr) return nullptr;
+
+    DialogueContextCreateOpts opts{};
+    opts.random_seed = random_seed;
+    opts.no_interpolate = !interpolate;
+
+    Diagnostic diagnostic{};
+    auto* ctx = ade_dialogue_ctx_create_shared(this->shared_ctx, &opts, &diagnostic);
+
+    if (ctx == nullptr)
+        UtilityFunctions::push_error("alternis: failed to create context for '", this->get_path(), "': ",
+                                     String::utf8(diagnostic.error_message.ptr, diagnostic.error_message.len));
+
+    ade_diagnostic_destroy(&diagnostic);
+    return ctx;
+}
+
+PackedStringArray AlternisDialogueResourceLoader::_get_recognized_extensions() const {
+    PackedStringArray result;
+    result.append("json");
+    return result;
+}
+
+// only claim json files which are explicitly alternis files, leave the rest to godot's json loader
+bool AlternisDialogueResourceLoader::_recognize_path(const String& path, const StringName& type) const {
+    return path.ends_with(".alternis.json");
+}
+
+bool AlternisDialogueResourceLoader::_handles_type(const StringName& type) const {
+    return type == StringName("AlternisDialogueResource");
+}
+
+String AlternisDialogueResourceLoader::_get_resource_type(const String& path) const {
+    return path.ends_with(".alternis.json") ? "AlternisDialogueResource" : "";
+}
+
+Variant AlternisDialogueResourceLoader::_load(const String& path, const String& original_path, bool use_sub_threads, int32_t cache_mode) const {
+    auto json_bytes = FileAccess::get_file_as_bytes(path);
+    if (json_bytes.is_empty()) {
+        // an empty file opens fine but can't be a dialogue
+        const Error open_error = FileAccess::get_open_error();
+        return open_error != OK ? open_error : ERR_PARSE_ERROR;
+    }
+
+    Ref<AlternisDialogueResource> resource;
+    resource.instantiate();
+    resource->start_compile(json_bytes);
+    return resource;
+}
+
+} // namespace alternis
@@ -0,0 +1,69 @@
+#ifndef ALTERNIS_DIALOGUE_RESOURCE_H
+#define ALTERNIS_DIALOGUE_RESOURCE_H
+
+#include <atomic>
+#include <godot_cpp/classes/resource.hpp>
+#include <godot_cpp/classes/resource_format_loader.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+#include <alternis.h>
+
+namespace alternis {
+
+/**
+ * A compiled alternis dialogue file, loaded through the ResourceLoader so that
+ * it is cached by path and shared by every AlternisDialogue node which refers to it.
+ * The json is compiled on a WorkerThreadPool thread, the "compiled" signal is
+ * emitted on the main thread once it is done.
+ */
+class AlternisDialogueResource : public godot::Resource {
+    GDCLASS(AlternisDialogueResource, godot::Resource)
+
+    godot::PackedByteArray json_bytes;
+    // the compiled context that node instances share, never stepped itself
+    DialogueContext* shared_ctx = nullptr;
+    godot::String error_message;
+
+    int64_t compile_task_id = -1;
+    std::atomic<bool> compiled{false};
+
+    void _compile();
+    void _wait_for_compile();
+
+protected:
+    static void _bind_methods();
+
+public:
+    AlternisDialogueResource();
+    ~AlternisDialogueResource();
+
+    // starts compiling the bytes on a worker thread
+    void start_compile(const godot::PackedByteArray& bytes);
+    void _finish_compile();
+
+    bool is_compiled() const;
+    godot::String get_error_message() const;
+
+    // creates a new context sharing the compiled dialogues, or null if compiling failed
+    // must not be called before is_compiled() is true
+    DialogueContext* create_context(uint64_t random_seed, bool interpolate) const;
+};
+
+class AlternisDialogueResourceLoader : public godot::ResourceFormatLoader {
+    GDCLASS(AlternisDialogueResourceLoader, godot::ResourceFormatLoader)
+
+protected:
+    static void _bind_methods() {}
+
+public:
+    virtual godot::PackedStringArray _get_recognized_extensions() const override;
+    virtual bool _recognize_path(const godot::String& path, const godot::StringName& type) const override;
+    virtual bool _handles_type(const godot::StringName& type) const override;
+    virtual godot::String _get_resource_type(const godot::String& path) const override;
+    virtual godot::Variant _load(const godot::String& path, const godot::String& original_path, bool use_sub_threads, int32_t cache_mode) const override;
+};
+
+} // namespace alternis
+
+#endif
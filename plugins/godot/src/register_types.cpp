@@ -1,21 +1,41 @@
 #include "register_types.h"
 
 #include "AlternisDialogue.h"
+#include "AlternisDialogueResource.h"
 
 #include <gdextension_interface.h>
 #include <godot_cpp/core/defs.hpp>
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/godot.hpp>
+#include <godot_cpp/classes/resource_loader.hpp>
+#include <godot_cpp/core/memory.hpp>
 
 using namespace godot;
 
+static Ref<alternis::AlternisDialogueResourceLoader> dialogue_resource_loader;
+
 void initialize_alternis_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) return;
+
+	// set once here rather than per node, since resources may compile before any node exists
+	ade_set_alloc(
+		(void*(*)(size_t)) ::godot::Memory::alloc_static,
+		(void(*)(void*)) ::godot::Memory::free_static
+	);
+
+	ClassDB::register_class<alternis::AlternisDialogueResource>();
+	ClassDB::register_class<alternis::AlternisDialogueResourceLoader>();
 	ClassDB::register_class<alternis::AlternisDialogue>();
+
+	dialogue_resource_loader.instantiate();
+	ResourceLoader::get_singleton()->add_resource_format_loader(dialogue_resource_loader, true);
 }
 
 void uninitialize_alternis_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) return;
+
+	ResourceLoader::get_singleton()->remove_resource_format_loader(dialogue_resource_loader);
+	dialogue_resource_loader.unref();
 }
 
 extern "C" {
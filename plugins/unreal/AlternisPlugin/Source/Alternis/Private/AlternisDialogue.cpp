@@ -5,19 +5,49 @@
 #include "Math/NumericLimits.h"
 #include "Templates/UnrealTypeTraits.h"
 #include "Containers/StringConv.h"
+#include "Tasks/Task.h"
+#include "Async/Async.h"
 
 #include "alternis.h"
 
-FStepResult::FStepResult(StepResult nativeResult)
+static_assert(sizeof(TCHAR) == sizeof(uint16), "alternis contexts are created with utf16 output, which requires a 2 byte TCHAR");
+
+// contexts are created with TEXT_ENCODING_UTF16, so this is a plain copy
+static FString FromAlternisString(const StringSlice& Slice)
+{
+    if (Slice.len == 0)
+        return FString{};
+    // NOTE: len is in bytes
+    return FString(static_cast<int32>(Slice.len / sizeof(TCHAR)), reinterpret_cast<const TCHAR*>(Slice.ptr));
+}
+
+// variable names and values are utf8 whatever the output encoding
+static FString FromUtf8(const StringSlice& Slice)
+{
+    FUTF8ToTCHAR Converted(Slice.ptr, static_cast<int32>(Slice.len));
+    return FString(Converted.Length(), Converted.Get());
+}
+
+static FName FNameFromUtf8(const StringSlice& Slice)
+{
+    FUTF8ToTCHAR Converted(Slice.ptr, static_cast<int32>(Slice.len));
+    return FName(Converted.Length(), Converted.Get());
+}
+
+FStepResult::FStepResult(const StepResult& nativeResult, TMap<const void*, FString>& SpeakerCache)
 {
     this->Type = (EStepType) nativeResult.tag;
 
     if (nativeResult.tag == STEP_RESULT_LINE)
     {
+        const FString* Speaker = SpeakerCache.Find(nativeResult.line.speaker.ptr);
+        if (Speaker == nullptr)
+            Speaker = &SpeakerCache.Add(nativeResult.line.speaker.ptr, FromAlternisString(nativeResult.line.speaker));
+
         this->Line = FAlternisLine{
-            FString(nativeResult.line.speaker.ptr, nativeResult.line.speaker.len),
-            FString(nativeResult.line.text.ptr, nativeResult.line.text.len),
-            FString(nativeResult.line.metadata.ptr, nativeResult.line.metadata.len)
+            *Speaker,
+            FromAlternisString(nativeResult.line.text),
+            FromAlternisString(nativeResult.line.metadata)
         };
     }
     else if (nativeResult.tag == STEP_RESULT_OPTIONS)
@@ -28,7 +58,7 @@ FStepResult::FStepResult(StepResult nativeResult)
         for (auto i = 0; i < nativeResult.options.texts.len; ++i)
         {
             options.Emplace(
-                FString(nativeResult.options.texts.ptr[i].text.ptr, nativeResult.options.texts.ptr[i].text.len),
+                FromAlternisString(nativeResult.options.texts.ptr[i].text),
                 nativeResult.options.ids.ptr[i]
             );
         }
@@ -61,29 +91,100 @@ static void _dispatch_callback(void* inCtx) {
     callback.Callback.Broadcast(callback.owner);
 }
 
-// FIXME: async loading for large dialogue files
-void UAlternisDialogue::BeginPlay() {
-    // FIXME: check, is this like reference count destroyed?
+// may be called from any thread, returns null on failure
+static DialogueContext* LoadContext(const FString& ResourcePath, uint64 RandomSeed, bool bInterpolate)
+{
     TArray<uint8> json_bytes;
-    FFileHelper::LoadFileToArray(json_bytes, *this->ResourcePath, EFileRead::FILEREAD_None);
+    if (!ensureMsgf(FFileHelper::LoadFileToArray(json_bytes, *ResourcePath, EFileRead::FILEREAD_None),
+                    TEXT("alternis: failed to read '%s'"), *ResourcePath))
+        return nullptr;
 
-    RandomSeed = this->RandomSeed == 0 ? FMath::RandRange(MIN_int64, MAX_int64) : this->RandomSeed;
+    DialogueContextCreateOpts opts{};
+    opts.random_seed = RandomSeed;
+    opts.no_interpolate = !bInterpolate;
+    opts.output_encoding = TEXT_ENCODING_UTF16;
 
-    const char* errPtr = nullptr;
+    Diagnostic diagnostic{};
 
-    this->ade_ctx = ade_dialogue_ctx_create_json(
+    DialogueContext* ctx = ade_dialogue_ctx_create_json_opts(
         reinterpret_cast<const char*>(json_bytes.GetData()),
         json_bytes.Num(),
-        RandomSeed,
-        !this->bInterpolate,
-        &errPtr
+        &opts,
+        &diagnostic
     );
 
-    if (!ensureMsgf(errPtr != nullptr, TEXT("alternis error: %s"), errPtr))
+    if (ctx == nullptr)
+    {
+        FUTF8ToTCHAR message(diagnostic.error_message.ptr, diagnostic.error_message.len);
+        ensureMsgf(false, TEXT("alternis error: %s"), *FString(message.Length(), message.Get()));
+    }
+
+    ade_diagnostic_destroy(&diagnostic);
+    return ctx;
+}
+
+void UAlternisDialogue::BeginPlay() {
+    Super::BeginPlay();
+
+    RandomSeed = this->RandomSeed == 0 ? FMath::RandRange(MIN_int64, MAX_int64) : this->RandomSeed;
+
+    if (!this->bLoadAsync)
+    {
+        this->OnContextLoaded(LoadContext(this->ResourcePath, this->RandomSeed, this->bInterpolate));
         return;
+    }
 
-    if (!ensureMsgf(this->ade_ctx != nullptr, TEXT("alternis: got invalid context")))
+    TWeakObjectPtr<UAlternisDialogue> WeakThis(this);
+
+    UE::Tasks::Launch(UE_SOURCE_LOCATION,
+        [WeakThis, Path = this->ResourcePath, Seed = this->RandomSeed, bInterp = this->bInterpolate]()
+        {
+            DialogueContext* LoadedContext = LoadContext(Path, Seed, bInterp);
+
+            AsyncTask(ENamedThreads::GameThread, [WeakThis, LoadedContext]()
+            {
+                UAlternisDialogue* This = WeakThis.Get();
+                if (This == nullptr)
+                {
+                    if (LoadedContext != nullptr) ade_dialogue_ctx_destroy(LoadedContext);
+                    return;
+                }
+                This->OnContextLoaded(LoadedContext);
+            });
+        });
+}
+
+// applies everything that was set before the context finished loading
+void UAlternisDialogue::OnContextLoaded(DialogueContext* LoadedContext)
+{
+    if (!ensureMsgf(LoadedContext != nullptr, TEXT("alternis: got invalid context")))
         return;
+
+    this->ade_ctx = LoadedContext;
+
+    StringSlice Name;
+    for (usz i = 0; ade_dialogue_ctx_get_variable_name(this->ade_ctx, VARIABLE_TYPE_BOOLEAN, i, &Name); ++i)
+        this->BooleanNames.Add(FNameFromUtf8(Name));
+    for (usz i = 0; ade_dialogue_ctx_get_variable_name(this->ade_ctx, VARIABLE_TYPE_STRING, i, &Name); ++i)
+        this->StringNames.Add(FNameFromUtf8(Name));
+
+    for (const auto& Entry : this->PendingBooleanVars)
+        this->SetVariableBoolean(Entry.Key, Entry.Value);
+    this->PendingBooleanVars.Empty();
+
+    for (const auto& Entry : this->PendingStringVars)
+        this->SetVariableString(Entry.Key, Entry.Value);
+    this->PendingStringVars.Empty();
+
+    for (const auto& Entry : TMap<FName, UAlternisCallback*>(this->Callbacks))
+        this->SetCallback(Entry.Key, Entry.Value);
+
+    this->OnLoaded.Broadcast(this);
+}
+
+bool UAlternisDialogue::IsLoaded() const
+{
+    return this->ade_ctx != nullptr;
 }
 
 FStepResult UAlternisDialogue::Step()
@@ -92,21 +193,44 @@ FStepResult UAlternisDialogue::Step()
         return FStepResult{};
 
     StepResult nativeResult;
-    ade_dialogue_ctx_step(this->ade_ctx, &nativeResult);
+    ade_dialogue_ctx_step(this->ade_ctx, 0, &nativeResult);
 
-    return FStepResult(nativeResult);
+    FStepResult Result(nativeResult, this->SpeakerCache);
+    this->BroadcastVariableChanges();
+    return Result;
+}
+
+void UAlternisDialogue::BroadcastVariableChanges()
+{
+    const uint64 Seq = ade_dialogue_ctx_latest_change_seq(this->ade_ctx);
+    if (Seq == this->LastChangeSeq)
+        return;
+    this->LastChangeSeq = Seq;
+
+    usz Indices[32];
+    for (const auto Type : {VARIABLE_TYPE_BOOLEAN, VARIABLE_TYPE_STRING})
+    {
+        const TArray<FName>& Names = Type == VARIABLE_TYPE_BOOLEAN ? this->BooleanNames : this->StringNames;
+        size_t Count;
+        do
+        {
+            Count = ade_dialogue_ctx_take_dirty_variables(this->ade_ctx, Type, Indices, UE_ARRAY_COUNT(Indices));
+            for (size_t i = 0; i < Count; ++i)
+                this->OnVariableChanged.Broadcast(this, Names[Indices[i]]);
+        } while (Count == UE_ARRAY_COUNT(Indices));
+    }
 }
 
 void UAlternisDialogue::Reset() {
     if (!ensureMsgf(this->ade_ctx != nullptr, TEXT("invalid alternis context")))
         return;
-    ade_dialogue_ctx_reset(this->ade_ctx);
+    ade_dialogue_ctx_reset(this->ade_ctx, 0, 0);
 }
 
 void UAlternisDialogue::Reply(int64 replyId) {
     if (!ensureMsgf(this->ade_ctx != nullptr, TEXT("invalid alternis context")))
         return;
-    ade_dialogue_ctx_reply(this->ade_ctx, replyId);
+    ade_dialogue_ctx_reply(this->ade_ctx, 0, replyId);
 }
 
 static void GetAnsiBuffFromFName(FName name, const ANSICHAR** outBuff, int32* outLen)
@@ -133,23 +257,34 @@ static void GetAnsiBuffFromFName(FName name, const ANSICHAR** outBuff, int32* ou
 }
 
 FString UAlternisDialogue::GetVariableString(const FName& name, bool& exists) {
-    auto found = this->StringVars.Find(name);
-
-    if (found == nullptr)
+    if (this->ade_ctx == nullptr)
     {
-        exists = false;
-        return FString{};
-    }
-    else
-    {
-        exists = true;
-        return *found;
+        auto found = this->PendingStringVars.Find(name);
+        exists = found != nullptr;
+        return exists ? *found : FString{};
     }
+
+    exists = this->StringNames.Contains(name);
+    if (!exists)
+        return FString{};
+
+    const ANSICHAR* namePtr;
+    int32 nameLen;
+    GetAnsiBuffFromFName(name, &namePtr, &nameLen);
+
+    StringSlice value;
+    ade_dialogue_ctx_get_variable_string(this->ade_ctx, namePtr, nameLen, &value);
+    return FromUtf8(value);
 }
 
 void UAlternisDialogue::SetVariableString(const FName& name, const FString& value) {
-    if (!ensureMsgf(this->ade_ctx != nullptr, TEXT("invalid alternis context")))
+    // applied once loaded
+    if (this->ade_ctx == nullptr)
+    {
+        // HACK: need to check FName garbage collection policy... I assume no gc per process atm unwisely
+        this->PendingStringVars.Add(name, value);
         return;
+    }
 
     const ANSICHAR* namePtr;
     int32 nameLen;
@@ -157,48 +292,55 @@ void UAlternisDialogue::SetVariableString(const FName& name, const FString& valu
 
     FTCHARToUTF8 asAscii(*value);
 
-    // HACK: need to check FName garbage collection policy... I assume no gc per process atm unwisely
-    this->StringVars.Add(name, value);
     ade_dialogue_ctx_set_variable_string(this->ade_ctx, namePtr, nameLen, asAscii.Get(), asAscii.Length());
+    this->BroadcastVariableChanges();
 }
 
 bool UAlternisDialogue::GetVariableBoolean(const FName& name, bool& exists) {
-    auto found = this->BooleanVars.Find(name);
-
-    if (found == nullptr)
-    {
-        exists = false;
-        return false;
-    }
-    else
+    if (this->ade_ctx == nullptr)
     {
-        exists = true;
-        return *found;
+        auto found = this->PendingBooleanVars.Find(name);
+        exists = found != nullptr;
+        return exists && *found;
     }
+
+    exists = this->BooleanNames.Contains(name);
+    if (!exists)
+        return false;
+
+    const ANSICHAR* namePtr;
+    int32 nameLen;
+    GetAnsiBuffFromFName(name, &namePtr, &nameLen);
+
+    return ade_dialogue_ctx_get_variable_boolean(this->ade_ctx, namePtr, nameLen);
 }
 
 void UAlternisDialogue::SetVariableBoolean(const FName& name, const bool value) {
-    if (!ensureMsgf(this->ade_ctx != nullptr, TEXT("invalid alternis context")))
+    // applied once loaded
+    if (this->ade_ctx == nullptr)
+    {
+        this->PendingBooleanVars.Add(name, value);
         return;
+    }
 
     const ANSICHAR* namePtr;
     int32 nameLen;
     GetAnsiBuffFromFName(name, &namePtr, &nameLen);
 
-    this->BooleanVars.Add(name, value);
-
     ade_dialogue_ctx_set_variable_boolean(this->ade_ctx, namePtr, nameLen, value);
+    this->BroadcastVariableChanges();
 }
 
 void UAlternisDialogue::SetCallback(const FName& name, UAlternisCallback* callable) {
-    if (!ensureMsgf(this->ade_ctx != nullptr, TEXT("invalid alternis context")))
+    this->Callbacks.Add(name, callable);
+
+    // applied once loaded
+    if (this->ade_ctx == nullptr)
         return;
 
     const ANSICHAR* namePtr;
     int32 nameLen;
     GetAnsiBuffFromFName(name, &namePtr, &nameLen);
 
-    this->Callbacks.Add(name, callable);
-
     ade_dialogue_ctx_set_callback(this->ade_ctx, namePtr, nameLen, _dispatch_callback, callable);
 }
\ No newline at end of file
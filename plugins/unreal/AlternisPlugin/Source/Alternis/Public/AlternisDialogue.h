@@ -71,7 +71,8 @@ struct FStepResult
 {
     GENERATED_BODY()
 
-    FStepResult(StepResult);
+    /** the native result must come from a context created with TEXT_ENCODING_UTF16 */
+    FStepResult(const StepResult&, TMap<const void*, FString>& SpeakerCache);
 
     UPROPERTY(BlueprintReadonly, Category="Alternis|Dialogue")
         EStepType Type;
@@ -91,6 +92,10 @@ class UAlternisDialogue;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FAlternisCallbackSignature, UAlternisDialogue*, DialogueContext);
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FAlternisLoadedSignature, UAlternisDialogue*, DialogueContext);
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FAlternisVariableChangedSignature, UAlternisDialogue*, DialogueContext, FName, VariableName);
+
 // NOTE: structs can't contain delegates so this is a full blown object :|
 UCLASS(BlueprintType)
 class UAlternisCallback : public UObject
@@ -119,10 +124,24 @@ class ALTERNIS_API UAlternisDialogue : public UActorComponent
 
     // FIXME: probably insidious bugs to do with pointer invalidation since
     // lib alternis is not id based yet
-    TMap<FName, FString> StringVars;
-    TMap<FName, bool> BooleanVars;
+    // variables set before the context finished loading, the context owns them once loaded
+    TMap<FName, FString> PendingStringVars;
+    TMap<FName, bool> PendingBooleanVars;
     TMap<FName, UAlternisCallback*> Callbacks;
 
+    // the names of the context's variables by their index, as reported in its change log
+    TArray<FName> StringNames;
+    TArray<FName> BooleanNames;
+    // the context's change sequence number when changes were last broadcast
+    uint64 LastChangeSeq = 0;
+
+    void BroadcastVariableChanges();
+
+    // speakers are transcoded once by the engine and have stable pointers, so their FStrings can be reused
+    TMap<const void*, FString> SpeakerCache;
+
+    void OnContextLoaded(DialogueContext* LoadedContext);
+
 public:
 
     UAlternisDialogue();
@@ -139,6 +158,22 @@ public:
     UPROPERTY(EditAnywhere, Category="Alternis|Dialogue")
         bool bInterpolate = true;
 
+    // load and parse the resource on a background task instead of blocking BeginPlay.
+    // Variables and callbacks set before it finishes are applied once it is loaded
+    UPROPERTY(EditAnywhere, Category="Alternis|Dialogue")
+        bool bLoadAsync = true;
+
+    // broadcast on the game thread once the dialogue is loaded and may be stepped
+    UPROPERTY(BlueprintAssignable, Category="Alternis|Dialogue")
+        FAlternisLoadedSignature OnLoaded;
+
+    // broadcast for each variable changed by a step or a setter, including lock and unlock nodes
+    UPROPERTY(BlueprintAssignable, Category="Alternis|Dialogue")
+        FAlternisVariableChangedSignature OnVariableChanged;
+
+    UFUNCTION(BlueprintPure)
+        bool IsLoaded() const;
+
     UFUNCTION(BlueprintCallable)
         void Reset();
 